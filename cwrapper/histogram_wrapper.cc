@@ -0,0 +1,122 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "histogram_wrapper.h"
+
+#include "Histogram.h"
+using PerfUtils::Histogram;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * This function is the wrapper for the Histogram constructor. The returned
+ * histogram must be freed with histogram_destroy.
+ */
+histogram*
+histogram_create(int significant_digits, uint64_t highest_trackable_value) {
+    return reinterpret_cast<histogram*>(
+        new Histogram(significant_digits, highest_trackable_value));
+}
+
+/**
+ * This function frees a histogram returned by histogram_create.
+ */
+void
+histogram_destroy(histogram* h) {
+    delete reinterpret_cast<Histogram*>(h);
+}
+
+/**
+ * This function is the wrapper for Histogram::record
+ */
+void
+histogram_record(histogram* h, uint64_t value) {
+    reinterpret_cast<Histogram*>(h)->record(value);
+}
+
+/**
+ * This function is the wrapper for Histogram::record with a count
+ */
+void
+histogram_record_count(histogram* h, uint64_t value, uint64_t count) {
+    reinterpret_cast<Histogram*>(h)->record(value, count);
+}
+
+/**
+ * This function is the wrapper for Histogram::recordWithExpectedInterval
+ */
+void
+histogram_record_corrected(histogram* h, uint64_t value,
+                           uint64_t expected_interval) {
+    reinterpret_cast<Histogram*>(h)->recordWithExpectedInterval(
+        value, expected_interval);
+}
+
+/**
+ * This function is the wrapper for Histogram::add
+ */
+void
+histogram_add(histogram* h, const histogram* other) {
+    reinterpret_cast<Histogram*>(h)->add(
+        *reinterpret_cast<const Histogram*>(other));
+}
+
+/**
+ * This function is the wrapper for Histogram::reset
+ */
+void
+histogram_reset(histogram* h) {
+    reinterpret_cast<Histogram*>(h)->reset();
+}
+
+/**
+ * This function is the wrapper for Histogram::getCount
+ */
+uint64_t
+histogram_count(const histogram* h) {
+    return reinterpret_cast<const Histogram*>(h)->getCount();
+}
+
+/**
+ * This function is the wrapper for Histogram::valueAtQuantile
+ */
+uint64_t
+histogram_value_at_quantile(const histogram* h, double quantile) {
+    return reinterpret_cast<const Histogram*>(h)->valueAtQuantile(quantile);
+}
+
+/**
+ * This function is the wrapper for Histogram::valuesAtQuantiles
+ */
+void
+histogram_values_at_quantiles(const histogram* h, const double* quantiles,
+                              uint64_t* values, size_t num_quantiles) {
+    reinterpret_cast<const Histogram*>(h)->valuesAtQuantiles(
+        quantiles, values, num_quantiles);
+}
+
+/**
+ * This function is the wrapper for Histogram::computeStatistics
+ */
+Statistics
+histogram_statistics(const histogram* h) {
+    return reinterpret_cast<const Histogram*>(h)->computeStatistics();
+}
+
+#ifdef __cplusplus
+}
+#endif
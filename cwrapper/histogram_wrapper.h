@@ -0,0 +1,51 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef WRAPPER_PERFUTIL_HISTOGRAM_H
+#define WRAPPER_PERFUTIL_HISTOGRAM_H
+
+#include <inttypes.h>
+
+#include "StatsMinimal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Opaque handle to a PerfUtils::Histogram.
+ */
+typedef struct histogram histogram;
+
+histogram* histogram_create(int significant_digits,
+                            uint64_t highest_trackable_value);
+void histogram_destroy(histogram* h);
+void histogram_record(histogram* h, uint64_t value);
+void histogram_record_count(histogram* h, uint64_t value, uint64_t count);
+void histogram_record_corrected(histogram* h, uint64_t value,
+                                uint64_t expected_interval);
+void histogram_add(histogram* h, const histogram* other);
+void histogram_reset(histogram* h);
+uint64_t histogram_count(const histogram* h);
+uint64_t histogram_value_at_quantile(const histogram* h, double quantile);
+void histogram_values_at_quantiles(const histogram* h, const double* quantiles,
+                                   uint64_t* values, size_t num_quantiles);
+struct Statistics histogram_statistics(const histogram* h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WRAPPER_PERFUTIL_HISTOGRAM_H
@@ -0,0 +1,64 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "histogram_wrapper.h"
+#include <stdio.h>
+
+#define RED(X)   "\033[31m"  X "\033[0m"
+#define GREEN(X) "\033[32m"  X "\033[0m"
+
+int
+main() {
+    histogram* h = histogram_create(3, 1000000);
+    for (uint64_t i = 0; i < 1000; i++)
+        histogram_record(h, i);
+    struct Statistics stats = histogram_statistics(h);
+    if (histogram_count(h) == 1000 && stats.count == 1000 && stats.min == 0 &&
+        stats.max == 999 && stats.median == 500 &&
+        histogram_value_at_quantile(h, 0.99) == 990) {
+        puts(GREEN("histogram_wrapper_test::statistics PASSED"));
+    } else {
+        puts(RED("histogram_wrapper_test::statistics FAILED"));
+    }
+
+    double quantiles[] = {0.99999, 0.5};
+    uint64_t values[2];
+    histogram_values_at_quantiles(h, quantiles, values, 2);
+    if (values[0] == 999 && values[1] == 500) {
+        puts(GREEN("histogram_wrapper_test::quantiles PASSED"));
+    } else {
+        puts(RED("histogram_wrapper_test::quantiles FAILED"));
+    }
+
+    histogram* other = histogram_create(3, 1000000);
+    histogram_record_count(other, 5000, 1000);
+    histogram_add(h, other);
+    stats = histogram_statistics(h);
+    if (stats.count == 2000 && stats.max == 5000 && stats.min == 0) {
+        puts(GREEN("histogram_wrapper_test::add PASSED"));
+    } else {
+        puts(RED("histogram_wrapper_test::add FAILED"));
+    }
+
+    histogram_reset(h);
+    if (histogram_count(h) == 0) {
+        puts(GREEN("histogram_wrapper_test::reset PASSED"));
+    } else {
+        puts(RED("histogram_wrapper_test::reset FAILED"));
+    }
+    histogram_destroy(other);
+    histogram_destroy(h);
+    return 0;
+}
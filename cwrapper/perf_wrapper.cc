@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include "perf_wrapper.h"
+
 #include "Perf.h"
 
 #ifdef __cplusplus
@@ -26,6 +28,43 @@ Statistics
 manualBench(void (*function)(uint64_t*), int numIterations) {
     return PerfUtils::manualBench(function, numIterations);
 }
+Statistics
+benchHistogram(void (*function)(void), int numIterations, histogram* h) {
+    return PerfUtils::bench(function, numIterations,
+                            reinterpret_cast<PerfUtils::Histogram*>(h));
+}
+Statistics
+manualBenchHistogram(void (*function)(uint64_t*), int numIterations,
+                     histogram* h) {
+    return PerfUtils::manualBench(function, numIterations,
+                                  reinterpret_cast<PerfUtils::Histogram*>(h));
+}
+void
+benchWithInterval(void (*function)(void), int numIterations,
+                  uint64_t expectedInterval, Statistics* raw,
+                  Statistics* corrected) {
+    PerfUtils::IntervalResult result = PerfUtils::benchWithInterval(
+        function, numIterations, expectedInterval);
+    *raw = result.raw;
+    *corrected = result.corrected;
+}
+void
+manualBenchWithInterval(void (*function)(uint64_t*), int numIterations,
+                        uint64_t expectedInterval, Statistics* raw,
+                        Statistics* corrected) {
+    PerfUtils::IntervalResult result = PerfUtils::manualBenchWithInterval(
+        function, numIterations, expectedInterval);
+    *raw = result.raw;
+    *corrected = result.corrected;
+}
+Statistics
+batchedBench(void (*function)(void), int numSamples, uint64_t sampleCycles,
+             int* batchSize) {
+    PerfUtils::BatchedResult result =
+        PerfUtils::batchedBench(function, numSamples, sampleCycles);
+    *batchSize = result.batchSize;
+    return result.perCall;
+}
 
 #ifdef __cplusplus
 }
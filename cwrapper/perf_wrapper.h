@@ -22,10 +22,23 @@ extern "C" {
 #endif
 
 #include "StatsMinimal.h"
+#include "histogram_wrapper.h"
 
 typedef struct Statistics Statistics;
 Statistics bench(void (*function)(void), int numIterations);
 Statistics manualBench(void (*function)(uint64_t*), int numIterations);
+Statistics benchHistogram(void (*function)(void), int numIterations,
+                          histogram* h);
+Statistics manualBenchHistogram(void (*function)(uint64_t*), int numIterations,
+                                histogram* h);
+void benchWithInterval(void (*function)(void), int numIterations,
+                       uint64_t expectedInterval, Statistics* raw,
+                       Statistics* corrected);
+void manualBenchWithInterval(void (*function)(uint64_t*), int numIterations,
+                             uint64_t expectedInterval, Statistics* raw,
+                             Statistics* corrected);
+Statistics batchedBench(void (*function)(void), int numSamples,
+                        uint64_t sampleCycles, int* batchSize);
 
 #ifdef __cplusplus
 }
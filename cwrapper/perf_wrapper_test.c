@@ -53,4 +53,31 @@ main() {
     } else {
         puts(RED("perf_wrapper_test::manualBench FAILED"));
     }
+
+    histogram* h = histogram_create(3, 1000000);
+    stats = manualBenchHistogram(fixedPerformance, 100000, h);
+    if (stats.count == 100000 && stats.average == 7 && stats.median == 7 &&
+        stats.min == 7 && stats.max == 7 && stats.stddev == 0) {
+        puts(GREEN("perf_wrapper_test::manualBenchHistogram PASSED"));
+    } else {
+        puts(RED("perf_wrapper_test::manualBenchHistogram FAILED"));
+    }
+    histogram_destroy(h);
+
+    Statistics raw, corrected;
+    manualBenchWithInterval(fixedPerformance, 100000, 5, &raw, &corrected);
+    if (raw.count == 100000 && raw.median == 7 && corrected.count == 100000 &&
+        corrected.median == 7) {
+        puts(GREEN("perf_wrapper_test::manualBenchWithInterval PASSED"));
+    } else {
+        puts(RED("perf_wrapper_test::manualBenchWithInterval FAILED"));
+    }
+
+    int batchSize;
+    stats = batchedBench(fiveHundredCycles, 100, 0, &batchSize);
+    if (stats.count == 100 && batchSize >= 1 && stats.median > 0) {
+        puts(GREEN("perf_wrapper_test::batchedBench PASSED"));
+    } else {
+        puts(RED("perf_wrapper_test::batchedBench FAILED"));
+    }
 }
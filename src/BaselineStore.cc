@@ -0,0 +1,357 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "BaselineStore.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include "Cycles.h"
+#include "SampleFile.h"
+#include "Util.h"
+#include "mkdir.h"
+
+namespace PerfUtils {
+
+static const char INDEX_HEADER[] = "# PerfUtils baselines 1";
+
+// Largest relative difference in cycle counter frequency between two runs
+// on the same host; calibration varies by much less than this, while a
+// change of CPU or of frequency settings varies by more.
+static const double FREQUENCY_TOLERANCE = 0.01;
+
+/**
+ * Return a fingerprint of the machine this process runs on.
+ */
+HostFingerprint
+currentHost() {
+    HostFingerprint host;
+    host.cpuModel = "unknown";
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") != 0)
+            continue;
+        size_t colon = line.find(':');
+        if (colon != std::string::npos && colon + 2 <= line.size()) {
+            host.cpuModel = line.substr(colon + 2);
+            std::replace(host.cpuModel.begin(), host.cpuModel.end(), '\t',
+                         ' ');
+        }
+        break;
+    }
+    host.cyclesPerSecond = Cycles::perSecond();
+    host.numCores = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    return host;
+}
+
+/**
+ * Return true if two fingerprints describe the same machine, so that
+ * benchmark results from one can be compared with the other.
+ *
+ * \param reason
+ *      If the hosts differ and this is not NULL, a description of the
+ *      first difference found is stored here.
+ */
+bool
+sameHost(const HostFingerprint& a, const HostFingerprint& b,
+         std::string* reason) {
+    std::string difference;
+    if (a.cpuModel != b.cpuModel) {
+        difference = Util::format("CPU model '%s' differs from '%s'",
+                                  a.cpuModel.c_str(), b.cpuModel.c_str());
+    } else if (a.numCores != b.numCores) {
+        difference = Util::format("%d cores differs from %d", a.numCores,
+                                  b.numCores);
+    } else if (fabs(a.cyclesPerSecond - b.cyclesPerSecond) >
+               FREQUENCY_TOLERANCE * b.cyclesPerSecond) {
+        difference = Util::format(
+            "cycle counter at %.1f MHz differs from %.1f MHz",
+            a.cyclesPerSecond / 1e6, b.cyclesPerSecond / 1e6);
+    } else {
+        return true;
+    }
+    if (reason != NULL)
+        *reason = difference;
+    return false;
+}
+
+/**
+ * Return the abbreviated git revision of the working directory, or
+ * "unknown" if it is not in a git repository.
+ */
+std::string
+currentRevision() {
+    FILE* git = popen("git rev-parse --short HEAD 2>/dev/null", "r");
+    if (git == NULL)
+        return "unknown";
+    char buffer[128];
+    std::string revision;
+    if (fgets(buffer, sizeof(buffer), git) != NULL)
+        revision = buffer;
+    if (pclose(git) != 0)
+        revision.clear();
+    while (!revision.empty() && isspace(revision.back()))
+        revision.pop_back();
+    return revision.empty() ? "unknown" : revision;
+}
+
+/**
+ * Return the FNV-1a hash of a string.
+ */
+static uint64_t
+hashString(const std::string& value) {
+    uint64_t hash = 14695981039346656037UL;
+    for (size_t i = 0; i < value.size(); i++) {
+        hash ^= static_cast<unsigned char>(value[i]);
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+/**
+ * Return value with every character that is not safe in a file name
+ * replaced by an underscore.
+ */
+static std::string
+fileNameSafe(const std::string& value) {
+    std::string safe = value;
+    for (size_t i = 0; i < safe.size(); i++) {
+        if (!isalnum(static_cast<unsigned char>(safe[i])) && safe[i] != '_' &&
+            safe[i] != '-' && safe[i] != '.')
+            safe[i] = '_';
+    }
+    return safe;
+}
+
+/**
+ * Die unless value can be stored as one field of the index.
+ */
+static void
+checkField(const std::string& value, const char* what) {
+    if (value.empty() || value.find_first_of("\t\n") != std::string::npos)
+        PERFUTILS_DIE("BaselineStore: %s '%s' is empty or contains a tab "
+                      "or newline", what, value.c_str());
+}
+
+/**
+ * Open a store, reading its index if it exists. The directory is created
+ * the first time something is saved.
+ *
+ * \param directory
+ *      Directory that holds the store.
+ */
+BaselineStore::BaselineStore(const char* directory)
+    : directory(directory),
+      entries() {
+    std::string path = this->directory + "/index";
+    std::ifstream index(path.c_str());
+    if (!index.is_open())
+        return;
+    std::string line;
+    if (!std::getline(index, line) || line != INDEX_HEADER)
+        PERFUTILS_DIE("BaselineStore: %s has an unsupported format",
+                      path.c_str());
+    while (std::getline(index, line)) {
+        if (line.empty())
+            continue;
+        std::vector<std::string> fields = Util::split(line, '\t');
+        if (fields.size() != 6)
+            PERFUTILS_DIE("BaselineStore: %s is corrupt: '%s'", path.c_str(),
+                          line.c_str());
+        Entry entry;
+        entry.name = fields[0];
+        entry.revision = fields[1];
+        entry.host.cyclesPerSecond = atof(fields[2].c_str());
+        entry.host.numCores = atoi(fields[3].c_str());
+        entry.host.cpuModel = fields[4];
+        entry.fileName = fields[5];
+        entries.push_back(entry);
+    }
+}
+
+/**
+ * Save the samples of a benchmark run, replacing any samples already
+ * saved for the same benchmark, revision and host.
+ *
+ * \param name
+ *      Name of the benchmark.
+ * \param revision
+ *      Revision of the code that was measured, such as the result of
+ *      currentRevision.
+ * \param host
+ *      Machine the samples were taken on, such as the result of
+ *      currentHost.
+ * \param samples
+ *      The samples, in cycles.
+ * \param count
+ *      Number of samples.
+ */
+void
+BaselineStore::save(const std::string& name, const std::string& revision,
+                    const HostFingerprint& host, const uint64_t* samples,
+                    size_t count) {
+    checkField(name, "benchmark name");
+    checkField(revision, "revision");
+    checkField(host.cpuModel, "CPU model");
+
+    Entry entry;
+    entry.name = name;
+    entry.revision = revision;
+    entry.host = host;
+    // The frequency is part of the key, rounded to the MHz, since hosts
+    // that differ only in frequency are different hosts to sameHost.
+    uint64_t hostKey = hashString(
+        Util::format("%s\t%d\t%.0f", host.cpuModel.c_str(), host.numCores,
+                     host.cyclesPerSecond / 1e6));
+    entry.fileName = Util::format("%s-%s-%016lx.samples",
+                                  fileNameSafe(name).c_str(),
+                                  fileNameSafe(revision).c_str(), hostKey);
+
+    // Rounding can still map two such hosts to one file; never overwrite
+    // the samples of an entry that is not being replaced.
+    size_t replaced = entries.size();
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (replaced == entries.size() && entries[i].name == name &&
+            entries[i].revision == revision &&
+            sameHost(entries[i].host, host, NULL))
+            replaced = i;
+        else if (entries[i].fileName == entry.fileName)
+            PERFUTILS_DIE("BaselineStore: %s already holds samples from "
+                          "another host", pathOf(entries[i]).c_str());
+    }
+    SampleFile::write(pathOf(entry).c_str(), name.c_str(), "cycles",
+                      host.cyclesPerSecond, samples, count);
+
+    if (replaced != entries.size()) {
+        if (entries[replaced].fileName != entry.fileName)
+            unlink(pathOf(entries[replaced]).c_str());
+        entries.erase(entries.begin() + replaced);
+    }
+    entries.push_back(entry);
+    writeIndex();
+}
+
+/**
+ * Return the most recent entry for a benchmark that was saved on the given
+ * host, or NULL if there is none.
+ *
+ * \param revision
+ *      If not empty, only entries for this revision are considered.
+ */
+const BaselineStore::Entry*
+BaselineStore::find(const std::string& name, const std::string& revision,
+                    const HostFingerprint& host) const {
+    for (size_t i = entries.size(); i > 0; i--) {
+        const Entry& entry = entries[i - 1];
+        if (entry.name == name &&
+            (revision.empty() || entry.revision == revision) &&
+            sameHost(entry.host, host, NULL))
+            return &entry;
+    }
+    return NULL;
+}
+
+/**
+ * Compare the samples of a benchmark run with the most recent baseline for
+ * the same benchmark from the same host. Baselines from other hosts are
+ * never used: if they are the only ones, the check reports
+ * BASELINE_HOST_MISMATCH instead of comparing.
+ *
+ * \param name
+ *      Name of the benchmark.
+ * \param revision
+ *      Revision of the baseline to use, or empty for the most recent.
+ * \param host
+ *      Machine the samples were taken on.
+ * \param samples
+ *      Samples of the run being checked, in cycles.
+ * \param count
+ *      Number of samples.
+ * \param options
+ *      Parameters for compare.
+ */
+BaselineCheck
+BaselineStore::check(const std::string& name, const std::string& revision,
+                     const HostFingerprint& host, const uint64_t* samples,
+                     size_t count, const CompareOptions& options) const {
+    BaselineCheck result;
+    result.status = BASELINE_MISSING;
+    result.comparison = Comparison();
+    const Entry* baseline = find(name, revision, host);
+    if (baseline != NULL) {
+        SampleFile file(pathOf(*baseline).c_str());
+        result.status = BASELINE_FOUND;
+        result.revision = baseline->revision;
+        result.comparison = compare(file.getSamples(), file.getCount(),
+                                    samples, count, options);
+        return result;
+    }
+    for (size_t i = entries.size(); i > 0; i--) {
+        const Entry& entry = entries[i - 1];
+        if (entry.name == name &&
+            (revision.empty() || entry.revision == revision)) {
+            result.status = BASELINE_HOST_MISMATCH;
+            result.revision = entry.revision;
+            sameHost(host, entry.host, &result.reason);
+            break;
+        }
+    }
+    return result;
+}
+
+/**
+ * Return the path of the sample file for an entry.
+ */
+std::string
+BaselineStore::pathOf(const Entry& entry) const {
+    return directory + "/" + entry.fileName;
+}
+
+/**
+ * Rewrite the index from entries. The new index is written to a temporary
+ * file and renamed over the old one, so a crash leaves one or the other.
+ */
+void
+BaselineStore::writeIndex() const {
+    std::string path = directory + "/index";
+    std::string temporary = path + ".tmp";
+    ensureParents(path.c_str());
+    FILE* index = fopen(temporary.c_str(), "w");
+    if (index == NULL)
+        PERFUTILS_DIE("BaselineStore couldn't create %s: %s",
+                      temporary.c_str(), strerror(errno));
+    fprintf(index, "%s\n", INDEX_HEADER);
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& entry = entries[i];
+        fprintf(index, "%s\t%s\t%.0f\t%d\t%s\t%s\n", entry.name.c_str(),
+                entry.revision.c_str(), entry.host.cyclesPerSecond,
+                entry.host.numCores, entry.host.cpuModel.c_str(),
+                entry.fileName.c_str());
+    }
+    if (fclose(index) != 0 || rename(temporary.c_str(), path.c_str()) != 0)
+        PERFUTILS_DIE("BaselineStore couldn't write %s: %s", path.c_str(),
+                      strerror(errno));
+}
+
+}  // namespace PerfUtils
@@ -0,0 +1,136 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PERFUTILS_BASELINESTORE_H
+#define PERFUTILS_BASELINESTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "Compare.h"
+
+namespace PerfUtils {
+
+/**
+ * Describes the machine a benchmark ran on, so that results from
+ * different machines are never compared with each other.
+ */
+struct HostFingerprint {
+    // The "model name" line of /proc/cpuinfo, or "unknown".
+    std::string cpuModel;
+
+    // Cycle counter frequency, as calibrated by Cycles.
+    double cyclesPerSecond;
+
+    // Number of cores online.
+    int numCores;
+};
+
+HostFingerprint currentHost();
+bool sameHost(const HostFingerprint& a, const HostFingerprint& b,
+              std::string* reason);
+std::string currentRevision();
+
+/**
+ * What BaselineStore::check found.
+ */
+enum BaselineStatus {
+    // There is a baseline from this host; the comparison is valid.
+    BASELINE_FOUND,
+    // There is no baseline for the benchmark.
+    BASELINE_MISSING,
+    // The only baselines for the benchmark come from other hosts, so no
+    // comparison was made.
+    BASELINE_HOST_MISMATCH
+};
+
+/**
+ * Result of BaselineStore::check.
+ */
+struct BaselineCheck {
+    BaselineStatus status;
+
+    // Revision of the baseline that was used, or that was refused.
+    std::string revision;
+
+    // For BASELINE_HOST_MISMATCH, how the hosts differ.
+    std::string reason;
+
+    // Valid only for BASELINE_FOUND.
+    Comparison comparison;
+};
+
+/**
+ * This class keeps the raw samples of benchmark runs in a directory, keyed
+ * by benchmark name, host and revision of the code, so that later runs
+ * can be checked for regressions against them.
+ *
+ * The directory holds one SampleFile per key and a text file named
+ * "index" that lists them, one per line, with tab-separated fields:
+ *
+ *     name revision cyclesPerSecond numCores cpuModel fileName
+ *
+ * The first line of the index gives the format version. Entries are kept
+ * in the order they were saved, so the last matching entry is the most
+ * recent; saving a key that already exists replaces its samples and moves
+ * it to the end.
+ *
+ * This class is not thread-safe, and a store should be used by one
+ * process at a time.
+ */
+class BaselineStore {
+  public:
+    /**
+     * One set of samples in the store.
+     */
+    struct Entry {
+        std::string name;
+        std::string revision;
+        HostFingerprint host;
+
+        // Name of the sample file, relative to the directory.
+        std::string fileName;
+    };
+
+    explicit BaselineStore(const char* directory);
+
+    void save(const std::string& name, const std::string& revision,
+              const HostFingerprint& host, const uint64_t* samples,
+              size_t count);
+    const Entry* find(const std::string& name, const std::string& revision,
+                      const HostFingerprint& host) const;
+    BaselineCheck check(const std::string& name, const std::string& revision,
+                        const HostFingerprint& host, const uint64_t* samples,
+                        size_t count,
+                        const CompareOptions& options = CompareOptions())
+        const;
+    std::string pathOf(const Entry& entry) const;
+
+    /// Return the entries in the store, oldest first.
+    const std::vector<Entry>& getEntries() const { return entries; }
+
+  private:
+    void writeIndex() const;
+
+    std::string directory;
+    std::vector<Entry> entries;
+};
+
+}  // namespace PerfUtils
+
+#endif  // PERFUTILS_BASELINESTORE_H
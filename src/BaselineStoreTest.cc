@@ -0,0 +1,191 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "BaselineStore.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "SampleFile.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::BaselineCheck;
+using PerfUtils::BaselineStore;
+using PerfUtils::HostFingerprint;
+
+/**
+ * Return a fingerprint for a made-up host.
+ */
+static HostFingerprint
+testHost() {
+    HostFingerprint host;
+    host.cpuModel = "Test CPU @ 2.00GHz";
+    host.cyclesPerSecond = 2e9;
+    host.numCores = 8;
+    return host;
+}
+
+/**
+ * Delete a store created by a test, and its directory.
+ */
+static void
+removeStore(const char* directory) {
+    BaselineStore store(directory);
+    for (const BaselineStore::Entry& entry : store.getEntries())
+        unlink(store.pathOf(entry).c_str());
+    unlink((std::string(directory) + "/index").c_str());
+    rmdir(directory);
+}
+
+TEST(BaselineStoreTest, currentHost) {
+    HostFingerprint host = PerfUtils::currentHost();
+    EXPECT_FALSE(host.cpuModel.empty());
+    EXPECT_LT(0, host.cyclesPerSecond);
+    EXPECT_LT(0, host.numCores);
+    EXPECT_TRUE(PerfUtils::sameHost(host, PerfUtils::currentHost(), NULL));
+    EXPECT_FALSE(PerfUtils::currentRevision().empty());
+}
+
+TEST(BaselineStoreTest, sameHost) {
+    HostFingerprint a = testHost();
+    HostFingerprint b = testHost();
+    std::string reason;
+    b.cyclesPerSecond = 2.01e9;
+    EXPECT_TRUE(PerfUtils::sameHost(a, b, &reason));
+    EXPECT_EQ("", reason);
+
+    b.cyclesPerSecond = 2.1e9;
+    EXPECT_FALSE(PerfUtils::sameHost(a, b, &reason));
+    EXPECT_EQ("cycle counter at 2000.0 MHz differs from 2100.0 MHz", reason);
+    b = testHost();
+    b.numCores = 4;
+    EXPECT_FALSE(PerfUtils::sameHost(a, b, &reason));
+    EXPECT_EQ("8 cores differs from 4", reason);
+    b = testHost();
+    b.cpuModel = "Other CPU";
+    EXPECT_FALSE(PerfUtils::sameHost(a, b, NULL));
+}
+
+TEST(BaselineStoreTest, saveAndFind) {
+    char dir[] = "/tmp/BaselineStoreTest_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    HostFingerprint host = testHost();
+    HostFingerprint other = testHost();
+    other.numCores = 16;
+    uint64_t samples[] = {1, 2, 3};
+
+    {
+        BaselineStore store(dir);
+        EXPECT_TRUE(store.getEntries().empty());
+        store.save("get", "abc123", host, samples, 3);
+        store.save("put", "abc123", host, samples, 2);
+        store.save("get", "def456", host, samples, 1);
+        store.save("get", "abc123", other, samples, 3);
+
+        // Saving the same key again replaces it and makes it the latest.
+        store.save("get", "abc123", host, samples, 2);
+    }
+
+    BaselineStore store(dir);
+    ASSERT_EQ(4U, store.getEntries().size());
+    const BaselineStore::Entry* entry = store.find("get", "", host);
+    ASSERT_TRUE(entry != NULL);
+    EXPECT_EQ("abc123", entry->revision);
+    EXPECT_EQ(host.cpuModel, entry->host.cpuModel);
+    EXPECT_EQ(2e9, entry->host.cyclesPerSecond);
+    EXPECT_EQ(8, entry->host.numCores);
+    EXPECT_EQ(2U, PerfUtils::SampleFile(store.pathOf(*entry).c_str())
+                      .getCount());
+
+    entry = store.find("get", "def456", host);
+    ASSERT_TRUE(entry != NULL);
+    EXPECT_EQ("def456", entry->revision);
+    EXPECT_EQ(16, store.find("get", "abc123", other)->host.numCores);
+    EXPECT_TRUE(store.find("get", "def456", other) == NULL);
+    EXPECT_TRUE(store.find("delete", "", host) == NULL);
+
+    removeStore(dir);
+}
+
+TEST(BaselineStoreTest, saveFrequencies) {
+    char dir[] = "/tmp/BaselineStoreTest_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    HostFingerprint host = testHost();
+    HostFingerprint faster = testHost();
+    faster.cyclesPerSecond = 2.1e9;
+    uint64_t samples[] = {1, 2, 3};
+
+    // Hosts that differ only in frequency keep separate samples.
+    BaselineStore store(dir);
+    store.save("get", "abc123", host, samples, 3);
+    store.save("get", "abc123", faster, samples, 1);
+    ASSERT_EQ(2U, store.getEntries().size());
+    std::string path = store.pathOf(*store.find("get", "", host));
+    EXPECT_EQ(3U, PerfUtils::SampleFile(path.c_str()).getCount());
+    EXPECT_EQ(1U, PerfUtils::SampleFile(
+                      store.pathOf(*store.find("get", "", faster)).c_str())
+                      .getCount());
+
+    // A frequency within the tolerance is the same host, so its samples
+    // replace the old ones even though the file name changes.
+    host.cyclesPerSecond = 2.004e9;
+    store.save("get", "abc123", host, samples, 2);
+    ASSERT_EQ(2U, store.getEntries().size());
+    EXPECT_NE(0, access(path.c_str(), F_OK));
+    EXPECT_EQ(2U, PerfUtils::SampleFile(
+                      store.pathOf(*store.find("get", "", host)).c_str())
+                      .getCount());
+
+    removeStore(dir);
+}
+
+TEST(BaselineStoreTest, check) {
+    char dir[] = "/tmp/BaselineStoreTest_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    HostFingerprint host = testHost();
+    std::vector<uint64_t> baseline(1000, 100);
+    std::vector<uint64_t> slower(1000, 200);
+    BaselineStore store(dir);
+    store.save("get", "abc123", host, baseline.data(), baseline.size());
+
+    BaselineCheck check = store.check("get", "", host, slower.data(),
+                                      slower.size());
+    EXPECT_EQ(PerfUtils::BASELINE_FOUND, check.status);
+    EXPECT_EQ("abc123", check.revision);
+    EXPECT_EQ(PerfUtils::REGRESSION, check.comparison.verdict);
+    EXPECT_EQ(1000U, check.comparison.baselineCount);
+
+    check = store.check("get", "", host, baseline.data(), baseline.size());
+    EXPECT_EQ(PerfUtils::NOISE, check.comparison.verdict);
+
+    check = store.check("put", "", host, slower.data(), slower.size());
+    EXPECT_EQ(PerfUtils::BASELINE_MISSING, check.status);
+    check = store.check("get", "def456", host, slower.data(), slower.size());
+    EXPECT_EQ(PerfUtils::BASELINE_MISSING, check.status);
+
+    HostFingerprint other = testHost();
+    other.cpuModel = "Other CPU";
+    check = store.check("get", "", other, slower.data(), slower.size());
+    EXPECT_EQ(PerfUtils::BASELINE_HOST_MISMATCH, check.status);
+    EXPECT_EQ("abc123", check.revision);
+    EXPECT_EQ("CPU model 'Other CPU' differs from 'Test CPU @ 2.00GHz'",
+              check.reason);
+
+    removeStore(dir);
+}
@@ -0,0 +1,444 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Benchmark.h"
+
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <regex>
+#include <utility>
+
+#include "BaselineStore.h"
+#include "Cycles.h"
+#include "Util.h"
+
+namespace PerfUtils {
+
+/**
+ * Register a benchmark that the runner times.
+ */
+BenchmarkRegistrar::BenchmarkRegistrar(const char* name,
+                                       void (*function)(void)) {
+    RegisteredBenchmark benchmark = {name, function, NULL};
+    registeredBenchmarks().push_back(benchmark);
+}
+
+/**
+ * Register a benchmark that reports its own times.
+ */
+BenchmarkRegistrar::BenchmarkRegistrar(const char* name,
+                                       void (*manualFunction)(uint64_t*)) {
+    RegisteredBenchmark benchmark = {name, NULL, manualFunction};
+    registeredBenchmarks().push_back(benchmark);
+}
+
+/**
+ * Return the registry of benchmarks, in the order they were registered.
+ * It is created on first use, so that registrars in other translation
+ * units can run before this one is initialized.
+ */
+std::vector<RegisteredBenchmark>&
+registeredBenchmarks() {
+    static std::vector<RegisteredBenchmark> benchmarks;
+    return benchmarks;
+}
+
+/**
+ * Print the command-line usage of benchmarkMain.
+ */
+static void
+printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -f, --filter REGEX     Run benchmarks whose names match\n"
+            "  -r, --repetitions N    Run each benchmark N times (1)\n"
+            "  -c, --core N           Pin the benchmarks to core N\n"
+            "  -t, --time SECONDS     Time budget per run (1)\n"
+            "  -n, --iterations N     Maximum samples per run (10000000)\n"
+            "  -o, --format FORMAT    csv or json (csv)\n"
+            "  -l, --list             List the matching benchmarks\n"
+            "  -s, --save DIR         Save the samples in the baseline "
+            "store DIR\n"
+            "  -C, --compare DIR      Check for regressions against the "
+            "baselines in DIR\n"
+            "      --revision REV     Revision to save under (git HEAD)\n"
+            "      --baseline-revision REV\n"
+            "                         Revision to compare with (latest)\n",
+            program);
+}
+
+/**
+ * Fill in runner options from command-line arguments; see printUsage for
+ * the options accepted.
+ *
+ * \return
+ *      False if the arguments are not valid, in which case the usage has
+ *      been printed to stderr.
+ */
+bool
+parseRunnerOptions(int argc, char** argv, RunnerOptions* options) {
+    static const struct option longOptions[] = {
+        {"filter", required_argument, NULL, 'f'},
+        {"repetitions", required_argument, NULL, 'r'},
+        {"core", required_argument, NULL, 'c'},
+        {"time", required_argument, NULL, 't'},
+        {"iterations", required_argument, NULL, 'n'},
+        {"format", required_argument, NULL, 'o'},
+        {"list", no_argument, NULL, 'l'},
+        {"save", required_argument, NULL, 's'},
+        {"compare", required_argument, NULL, 'C'},
+        {"revision", required_argument, NULL, 'R'},
+        {"baseline-revision", required_argument, NULL, 'B'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+
+    // Reset getopt, in case it has already been used in this process.
+    optind = 0;
+    int option;
+    while ((option = getopt_long(argc, argv, "f:r:c:t:n:o:ls:C:h", longOptions,
+                                 NULL)) != -1) {
+        switch (option) {
+            case 'f':
+                options->filter = optarg;
+                break;
+            case 'r':
+                options->repetitions = atoi(optarg);
+                break;
+            case 'c':
+                options->core = atoi(optarg);
+                break;
+            case 't':
+                options->timeBudget = atof(optarg);
+                break;
+            case 'n':
+                options->maxIterations = strtoull(optarg, NULL, 0);
+                break;
+            case 'o':
+                if (strcmp(optarg, "csv") == 0) {
+                    options->format = CSV_FORMAT;
+                } else if (strcmp(optarg, "json") == 0) {
+                    options->format = JSON_FORMAT;
+                } else {
+                    printUsage(argv[0]);
+                    return false;
+                }
+                break;
+            case 'l':
+                options->list = true;
+                break;
+            case 's':
+                options->saveDirectory = optarg;
+                break;
+            case 'C':
+                options->compareDirectory = optarg;
+                break;
+            case 'R':
+                options->revision = optarg;
+                break;
+            case 'B':
+                options->baselineRevision = optarg;
+                break;
+            default:
+                printUsage(argv[0]);
+                return false;
+        }
+    }
+    if (optind < argc || options->repetitions < 1 ||
+        options->maxIterations < 1) {
+        printUsage(argv[0]);
+        return false;
+    }
+    try {
+        std::regex check(options->filter);
+    } catch (const std::regex_error& e) {
+        fprintf(stderr, "Invalid filter '%s': %s\n", options->filter.c_str(),
+                e.what());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Return the registered benchmarks whose names match a filter.
+ */
+static std::vector<RegisteredBenchmark>
+matchingBenchmarks(const std::string& filter) {
+    std::regex pattern(filter);
+    std::vector<RegisteredBenchmark> matches;
+    std::vector<RegisteredBenchmark>& benchmarks = registeredBenchmarks();
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+        if (std::regex_search(benchmarks[i].name, pattern))
+            matches.push_back(benchmarks[i]);
+    }
+    return matches;
+}
+
+/**
+ * Run a benchmark once, calling it in rounds until the time budget or
+ * the iteration limit runs out, and return its samples.
+ */
+static std::vector<uint64_t>
+runOnce(const RegisteredBenchmark& benchmark, const RunnerOptions& options) {
+    static const uint64_t ROUND_SIZE = 1000;
+    std::vector<uint64_t> samples;
+    uint64_t deadline =
+        Cycles::rdtsc() + Cycles::fromSeconds(options.timeBudget);
+    do {
+        size_t start = samples.size();
+        size_t count = std::min(ROUND_SIZE, options.maxIterations - start);
+        samples.resize(start + count);
+        uint64_t* latencies = samples.data() + start;
+        if (benchmark.function != NULL) {
+            uint64_t startTime;
+            for (size_t i = 0; i < count; i++) {
+                startTime = Cycles::rdtsc();
+                benchmark.function();
+                latencies[i] = Cycles::rdtsc() - startTime;
+            }
+        } else {
+            for (size_t i = 0; i < count; i++)
+                benchmark.manualFunction(&latencies[i]);
+        }
+    } while (samples.size() < options.maxIterations &&
+             Cycles::rdtsc() < deadline);
+    return samples;
+}
+
+/**
+ * Run each registered benchmark that matches options.filter, the given
+ * number of times, and return the statistics for each run.
+ */
+std::vector<BenchmarkRun>
+runBenchmarks(const RunnerOptions& options) {
+    cpu_set_t savedAffinity = Util::getCpuAffinity();
+    if (options.core >= 0)
+        Util::pinThreadToCore(options.core);
+
+    bool keepSamples = !options.saveDirectory.empty() ||
+                       !options.compareDirectory.empty();
+    std::vector<BenchmarkRun> runs;
+    std::vector<RegisteredBenchmark> benchmarks =
+        matchingBenchmarks(options.filter);
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+        for (int repetition = 0; repetition < options.repetitions;
+             repetition++) {
+            std::vector<uint64_t> samples = runOnce(benchmarks[i], options);
+            BenchmarkRun run;
+            run.name = benchmarks[i].name;
+            run.repetition = repetition;
+            run.stats = computeStatistics(samples.data(), samples.size());
+            if (keepSamples)
+                run.samples.swap(samples);
+            runs.push_back(run);
+        }
+    }
+
+    if (options.core >= 0)
+        Util::setCpuAffinity(savedAffinity);
+    return runs;
+}
+
+/**
+ * Print a string as a JSON string literal.
+ */
+static void
+printJsonString(const std::string& value, FILE* out) {
+    fputc('"', out);
+    for (size_t i = 0; i < value.size(); i++) {
+        char c = value[i];
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (static_cast<unsigned char>(c) < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+/**
+ * Print the results of runBenchmarks. CSV has the columns of
+ * printStatistics plus the repetition; JSON is an object holding the
+ * cycle counter frequency and an array with one object per run. All
+ * times are in cycles.
+ */
+void
+printBenchmarkRuns(const std::vector<BenchmarkRun>& runs,
+                   BenchmarkFormat format, FILE* out) {
+    if (format == CSV_FORMAT) {
+        fprintf(out, "Benchmark,Repetition,Count,Avg,Stddev,Median,Min,"
+                     "99%%,99.9%%,99.99%%,Max\n");
+        for (size_t i = 0; i < runs.size(); i++) {
+            const Statistics& stats = runs[i].stats;
+            fprintf(out, "%s,%d,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+                    runs[i].name.c_str(), runs[i].repetition, stats.count,
+                    stats.average, stats.stddev, stats.median, stats.min,
+                    stats.P99, stats.P999, stats.P9999, stats.max);
+        }
+        return;
+    }
+
+    fprintf(out, "{\n  \"cyclesPerSecond\": %.0f,\n  \"benchmarks\": [",
+            Cycles::perSecond());
+    for (size_t i = 0; i < runs.size(); i++) {
+        const Statistics& stats = runs[i].stats;
+        fprintf(out, "%s\n    {\"name\": ", i == 0 ? "" : ",");
+        printJsonString(runs[i].name, out);
+        fprintf(out,
+                ", \"repetition\": %d, \"count\": %lu, \"average\": %lu, "
+                "\"stddev\": %lu, \"median\": %lu, \"min\": %lu, "
+                "\"P99\": %lu, \"P999\": %lu, \"P9999\": %lu, "
+                "\"max\": %lu}",
+                runs[i].repetition, stats.count, stats.average,
+                stats.stddev, stats.median, stats.min, stats.P99,
+                stats.P999, stats.P9999, stats.max);
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+/**
+ * Return the names of the benchmarks in runs, in order, each with the
+ * samples of all its repetitions.
+ */
+static std::vector<std::pair<std::string, std::vector<uint64_t>>>
+samplesByBenchmark(const std::vector<BenchmarkRun>& runs) {
+    std::vector<std::pair<std::string, std::vector<uint64_t>>> benchmarks;
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (benchmarks.empty() || benchmarks.back().first != runs[i].name) {
+            benchmarks.push_back(
+                std::make_pair(runs[i].name, std::vector<uint64_t>()));
+        }
+        std::vector<uint64_t>& samples = benchmarks.back().second;
+        samples.insert(samples.end(), runs[i].samples.begin(),
+                       runs[i].samples.end());
+    }
+    return benchmarks;
+}
+
+/**
+ * Save the samples of each benchmark in runs, all repetitions together,
+ * in the BaselineStore in options.saveDirectory, under options.revision
+ * and the current host. The runs must have been made with the same
+ * options, so that their samples were kept.
+ */
+void
+saveBaselines(const std::vector<BenchmarkRun>& runs,
+              const RunnerOptions& options) {
+    BaselineStore store(options.saveDirectory.c_str());
+    std::string revision =
+        options.revision.empty() ? currentRevision() : options.revision;
+    HostFingerprint host = currentHost();
+    std::vector<std::pair<std::string, std::vector<uint64_t>>> benchmarks =
+        samplesByBenchmark(runs);
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+        const std::vector<uint64_t>& samples = benchmarks[i].second;
+        store.save(benchmarks[i].first, revision, host, samples.data(),
+                   samples.size());
+    }
+}
+
+/**
+ * Check the samples of each benchmark in runs, all repetitions together,
+ * for regressions against the BaselineStore in
+ * options.compareDirectory. The comparisons are printed as by
+ * printComparison, after a header if there are any; benchmarks without a
+ * baseline, and baselines that were refused because they come from
+ * another host, are reported on stderr.
+ *
+ * \return
+ *      2 if any benchmark regressed, otherwise 1 if any baseline was
+ *      refused, otherwise 0.
+ */
+int
+checkBaselines(const std::vector<BenchmarkRun>& runs,
+               const RunnerOptions& options, FILE* out) {
+    BaselineStore store(options.compareDirectory.c_str());
+    HostFingerprint host = currentHost();
+    bool regressed = false;
+    bool refused = false;
+    bool headerPrinted = false;
+    std::vector<std::pair<std::string, std::vector<uint64_t>>> benchmarks =
+        samplesByBenchmark(runs);
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+        const std::string& name = benchmarks[i].first;
+        const std::vector<uint64_t>& samples = benchmarks[i].second;
+        BaselineCheck check =
+            store.check(name, options.baselineRevision, host, samples.data(),
+                        samples.size());
+        switch (check.status) {
+            case BASELINE_FOUND:
+                if (!headerPrinted) {
+                    printComparisonHeader(out);
+                    headerPrinted = true;
+                }
+                printComparison(check.comparison, name.c_str(), out);
+                regressed |= check.comparison.verdict == REGRESSION;
+                break;
+            case BASELINE_HOST_MISMATCH:
+                fprintf(stderr,
+                        "%s: refusing to compare with baseline %s from "
+                        "another host: %s\n",
+                        name.c_str(), check.revision.c_str(),
+                        check.reason.c_str());
+                refused = true;
+                break;
+            default:
+                fprintf(stderr, "%s: no baseline\n", name.c_str());
+                break;
+        }
+    }
+    return regressed ? 2 : refused ? 1 : 0;
+}
+
+/**
+ * Parse the command line, then list or run the registered benchmarks and
+ * print the results to stdout, and any comparisons with baselines to
+ * stderr. A suite of benchmarks defined with PERFUTILS_BENCHMARK needs
+ * only a main that returns this.
+ *
+ * \return
+ *      The exit status for the program: 1 if the arguments are not valid,
+ *      and otherwise as for checkBaselines, or 0 if nothing was compared.
+ */
+int
+benchmarkMain(int argc, char** argv) {
+    RunnerOptions options;
+    if (!parseRunnerOptions(argc, argv, &options))
+        return 1;
+    if (options.list) {
+        std::vector<RegisteredBenchmark> benchmarks =
+            matchingBenchmarks(options.filter);
+        for (size_t i = 0; i < benchmarks.size(); i++)
+            printf("%s\n", benchmarks[i].name);
+        return 0;
+    }
+    std::vector<BenchmarkRun> runs = runBenchmarks(options);
+    printBenchmarkRuns(runs, options.format, stdout);
+
+    // Comparisons are checked before saving, so that a run can be saved
+    // over the baseline it was checked against. They go to stderr, so that
+    // stdout holds only the table of runs in either format.
+    int status = 0;
+    if (!options.compareDirectory.empty())
+        status = checkBaselines(runs, options, stderr);
+    if (!options.saveDirectory.empty())
+        saveBaselines(runs, options);
+    return status;
+}
+
+}  // namespace PerfUtils
@@ -0,0 +1,173 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PERFUTILS_BENCHMARK_H
+#define PERFUTILS_BENCHMARK_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "Stats.h"
+
+/**
+ * Define a benchmark and add it to the registry that benchmarkMain runs.
+ * The body that follows is one operation; the runner times each call.
+ *
+ *     PERFUTILS_BENCHMARK(readTsc) {
+ *         PerfUtils::doNotOptimize(PerfUtils::Cycles::rdtsc());
+ *     }
+ */
+#define PERFUTILS_BENCHMARK(name)                                       \
+    static void name();                                                 \
+    static PerfUtils::BenchmarkRegistrar name##Registrar(#name, name);  \
+    static void name()
+
+/**
+ * Define a benchmark that times itself, as with manualBench: the body
+ * stores the time for one operation, in cycles, in *elapsed.
+ *
+ *     PERFUTILS_MANUAL_BENCHMARK(lockHandoff, elapsed) {
+ *         ...
+ *         *elapsed = end - start;
+ *     }
+ */
+#define PERFUTILS_MANUAL_BENCHMARK(name, elapsed)                       \
+    static void name(uint64_t* elapsed);                                \
+    static PerfUtils::BenchmarkRegistrar name##Registrar(#name, name);  \
+    static void name(uint64_t* elapsed)
+
+namespace PerfUtils {
+
+/**
+ * A benchmark in the registry.
+ */
+struct RegisteredBenchmark {
+    const char* name;
+
+    // Exactly one of these is set: function is timed by the runner, and
+    // manualFunction reports its own times.
+    void (*function)(void);
+    void (*manualFunction)(uint64_t*);
+};
+
+/**
+ * Adds a benchmark to the registry when it is constructed; the
+ * PERFUTILS_BENCHMARK macros define one of these for each benchmark.
+ */
+class BenchmarkRegistrar {
+  public:
+    BenchmarkRegistrar(const char* name, void (*function)(void));
+    BenchmarkRegistrar(const char* name, void (*manualFunction)(uint64_t*));
+};
+
+std::vector<RegisteredBenchmark>& registeredBenchmarks();
+
+/**
+ * How runBenchmarks reports its results.
+ */
+enum BenchmarkFormat {
+    CSV_FORMAT,
+    JSON_FORMAT
+};
+
+/**
+ * Parameters for runBenchmarks; benchmarkMain fills them in from the
+ * command line.
+ */
+struct RunnerOptions {
+    RunnerOptions()
+        : filter(),
+          repetitions(1),
+          core(-1),
+          timeBudget(1.0),
+          maxIterations(10000000),
+          format(CSV_FORMAT),
+          list(false),
+          saveDirectory(),
+          compareDirectory(),
+          revision(),
+          baselineRevision() {}
+
+    // ECMAScript regular expression; only benchmarks whose names contain a
+    // match are run. Empty runs them all.
+    std::string filter;
+
+    // Number of times each benchmark is run; each run is reported
+    // separately.
+    int repetitions;
+
+    // Core that the benchmarks run on, or -1 to leave them unpinned.
+    int core;
+
+    // Seconds that each run of a benchmark may take.
+    double timeBudget;
+
+    // Upper limit on the number of samples in a run; this bounds the
+    // memory used at 8 bytes per sample.
+    uint64_t maxIterations;
+
+    BenchmarkFormat format;
+
+    // If true, print the names of the matching benchmarks instead of
+    // running them.
+    bool list;
+
+    // If not empty, the samples of each benchmark are saved in the
+    // BaselineStore in this directory.
+    std::string saveDirectory;
+
+    // If not empty, each benchmark is checked for regressions against the
+    // BaselineStore in this directory.
+    std::string compareDirectory;
+
+    // Revision the samples are saved under; empty uses currentRevision.
+    std::string revision;
+
+    // Revision of the baselines to compare with; empty uses the most
+    // recent one saved on this host.
+    std::string baselineRevision;
+};
+
+/**
+ * The result of one run of one benchmark.
+ */
+struct BenchmarkRun {
+    std::string name;
+    int repetition;
+
+    // Statistics on the samples of the run, in cycles.
+    Statistics stats;
+
+    // The samples themselves, in no particular order; kept only if the
+    // options save or compare them, and empty otherwise.
+    std::vector<uint64_t> samples;
+};
+
+bool parseRunnerOptions(int argc, char** argv, RunnerOptions* options);
+std::vector<BenchmarkRun> runBenchmarks(const RunnerOptions& options);
+void printBenchmarkRuns(const std::vector<BenchmarkRun>& runs,
+                        BenchmarkFormat format, FILE* out);
+void saveBaselines(const std::vector<BenchmarkRun>& runs,
+                   const RunnerOptions& options);
+int checkBaselines(const std::vector<BenchmarkRun>& runs,
+                   const RunnerOptions& options, FILE* out);
+int benchmarkMain(int argc, char** argv);
+
+}  // namespace PerfUtils
+
+#endif  // PERFUTILS_BENCHMARK_H
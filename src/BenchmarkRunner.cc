@@ -0,0 +1,52 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * This program runs the benchmarks registered with PERFUTILS_BENCHMARK; see
+ * benchmarkMain for its options. It includes benchmarks of the PerfUtils
+ * primitives that are themselves used to take measurements, so that their
+ * costs can be checked on each machine; a suite of other benchmarks can be
+ * linked into it, or into a copy of its main.
+ */
+
+#include "Benchmark.h"
+#include "Cycles.h"
+#include "Histogram.h"
+#include "Perf.h"
+
+using PerfUtils::Cycles;
+
+PERFUTILS_BENCHMARK(rdtsc) {
+    PerfUtils::doNotOptimize(Cycles::rdtsc());
+}
+
+PERFUTILS_BENCHMARK(rdtscp) {
+    PerfUtils::doNotOptimize(Cycles::rdtscp());
+}
+
+PERFUTILS_BENCHMARK(rdtscFenced) {
+    PerfUtils::doNotOptimize(Cycles::rdtscFenced());
+}
+
+PERFUTILS_BENCHMARK(histogramRecord) {
+    static PerfUtils::Histogram histogram;
+    static uint64_t value = 0;
+    histogram.record(value++ & 0xffff);
+}
+
+int
+main(int argc, char** argv) {
+    return PerfUtils::benchmarkMain(argc, argv);
+}
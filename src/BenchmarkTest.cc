@@ -0,0 +1,194 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "BaselineStore.h"
+#include "SampleFile.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::BenchmarkRun;
+using PerfUtils::RunnerOptions;
+
+static int spinCalls = 0;
+
+PERFUTILS_BENCHMARK(testSpin) {
+    spinCalls++;
+}
+
+PERFUTILS_MANUAL_BENCHMARK(testManual, elapsed) {
+    *elapsed = 7;
+}
+
+/**
+ * Parse a command line given as a list of arguments.
+ */
+static bool
+parse(std::vector<const char*> args, RunnerOptions* options) {
+    args.insert(args.begin(), "BenchmarkTest");
+    return PerfUtils::parseRunnerOptions(
+        static_cast<int>(args.size()), const_cast<char**>(args.data()),
+        options);
+}
+
+/**
+ * Return everything printBenchmarkRuns writes for runs.
+ */
+static std::string
+printed(const std::vector<BenchmarkRun>& runs,
+        PerfUtils::BenchmarkFormat format) {
+    FILE* out = tmpfile();
+    PerfUtils::printBenchmarkRuns(runs, format, out);
+    std::string text(ftell(out), '\0');
+    rewind(out);
+    EXPECT_EQ(text.size(), fread(&text[0], 1, text.size(), out));
+    fclose(out);
+    return text;
+}
+
+TEST(BenchmarkTest, registry) {
+    std::vector<PerfUtils::RegisteredBenchmark>& benchmarks =
+        PerfUtils::registeredBenchmarks();
+    ASSERT_EQ(2U, benchmarks.size());
+    EXPECT_STREQ("testSpin", benchmarks[0].name);
+    EXPECT_TRUE(benchmarks[0].function != NULL);
+    EXPECT_STREQ("testManual", benchmarks[1].name);
+    EXPECT_TRUE(benchmarks[1].manualFunction != NULL);
+}
+
+TEST(BenchmarkTest, parseRunnerOptions) {
+    RunnerOptions options;
+    EXPECT_TRUE(parse({"--filter", "Spin$", "-r", "3", "--core", "0",
+                       "--time", "0.5", "-n", "100", "--format", "json",
+                       "--list"}, &options));
+    EXPECT_EQ("Spin$", options.filter);
+    EXPECT_EQ(3, options.repetitions);
+    EXPECT_EQ(0, options.core);
+    EXPECT_DOUBLE_EQ(0.5, options.timeBudget);
+    EXPECT_EQ(100U, options.maxIterations);
+    EXPECT_EQ(PerfUtils::JSON_FORMAT, options.format);
+    EXPECT_TRUE(options.list);
+
+    RunnerOptions store;
+    EXPECT_TRUE(parse({"-s", "new", "--compare", "old", "--revision", "abc",
+                       "--baseline-revision", "def"}, &store));
+    EXPECT_EQ("new", store.saveDirectory);
+    EXPECT_EQ("old", store.compareDirectory);
+    EXPECT_EQ("abc", store.revision);
+    EXPECT_EQ("def", store.baselineRevision);
+
+    RunnerOptions bad;
+    EXPECT_FALSE(parse({"--format", "xml"}, &bad));
+    EXPECT_FALSE(parse({"--filter", "("}, &bad));
+    EXPECT_FALSE(parse({"-r", "0"}, &bad));
+    EXPECT_FALSE(parse({"extra"}, &bad));
+}
+
+TEST(BenchmarkTest, runBenchmarks) {
+    RunnerOptions options;
+    options.filter = "Spin";
+    options.repetitions = 2;
+    options.maxIterations = 1500;
+    spinCalls = 0;
+    std::vector<BenchmarkRun> runs = PerfUtils::runBenchmarks(options);
+    ASSERT_EQ(2U, runs.size());
+    EXPECT_EQ("testSpin", runs[0].name);
+    EXPECT_EQ(0, runs[0].repetition);
+    EXPECT_EQ(1, runs[1].repetition);
+    EXPECT_EQ(1500U, runs[0].stats.count);
+    EXPECT_EQ(3000, spinCalls);
+
+    options.filter = "Manual";
+    options.repetitions = 1;
+    options.timeBudget = 0;
+    runs = PerfUtils::runBenchmarks(options);
+    ASSERT_EQ(1U, runs.size());
+    EXPECT_EQ(1000U, runs[0].stats.count);
+    EXPECT_EQ(7U, runs[0].stats.max);
+}
+
+TEST(BenchmarkTest, printBenchmarkRuns) {
+    RunnerOptions options;
+    options.filter = "Manual";
+    options.maxIterations = 10;
+    std::vector<BenchmarkRun> runs = PerfUtils::runBenchmarks(options);
+    EXPECT_EQ("Benchmark,Repetition,Count,Avg,Stddev,Median,Min,99%,99.9%,"
+              "99.99%,Max\ntestManual,0,10,7,0,7,7,7,7,7,7\n",
+              printed(runs, PerfUtils::CSV_FORMAT));
+
+    std::string json = printed(runs, PerfUtils::JSON_FORMAT);
+    EXPECT_NE(std::string::npos, json.find("\"cyclesPerSecond\": "));
+    EXPECT_NE(std::string::npos,
+              json.find("{\"name\": \"testManual\", \"repetition\": 0, "
+                        "\"count\": 10, \"average\": 7, \"stddev\": 0, "
+                        "\"median\": 7, \"min\": 7, \"P99\": 7, "
+                        "\"P999\": 7, \"P9999\": 7, \"max\": 7}"));
+}
+
+TEST(BenchmarkTest, baselines) {
+    char dir[] = "/tmp/BenchmarkTest_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    RunnerOptions options;
+    options.filter = "Manual";
+    options.maxIterations = 100;
+    options.repetitions = 2;
+    options.saveDirectory = dir;
+    options.compareDirectory = dir;
+    options.revision = "abc123";
+    std::vector<BenchmarkRun> runs = PerfUtils::runBenchmarks(options);
+    ASSERT_EQ(2U, runs.size());
+    EXPECT_EQ(100U, runs[0].samples.size());
+
+    FILE* out = tmpfile();
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(0, PerfUtils::checkBaselines(runs, options, out));
+    EXPECT_EQ("testManual: no baseline\n",
+              testing::internal::GetCapturedStderr());
+    PerfUtils::saveBaselines(runs, options);
+
+    PerfUtils::BaselineStore store(dir);
+    ASSERT_EQ(1U, store.getEntries().size());
+    EXPECT_EQ("abc123", store.getEntries()[0].revision);
+    EXPECT_EQ(200U, PerfUtils::SampleFile(
+                        store.pathOf(store.getEntries()[0]).c_str())
+                        .getCount());
+
+    // The same samples again are not a regression.
+    EXPECT_EQ(0, PerfUtils::checkBaselines(runs, options, out));
+    EXPECT_LT(0, ftell(out));
+    rewind(out);
+    char line[100];
+    ASSERT_TRUE(fgets(line, sizeof(line), out) != NULL);
+    EXPECT_STREQ("Benchmark,Statistic,Baseline,Candidate,Change,Lower,Upper,"
+                 "PValue,Verdict\n", line);
+    fclose(out);
+
+    unlink(store.pathOf(store.getEntries()[0]).c_str());
+    unlink((std::string(dir) + "/index").c_str());
+    rmdir(dir);
+
+    options.saveDirectory.clear();
+    options.compareDirectory.clear();
+    runs = PerfUtils::runBenchmarks(options);
+    EXPECT_TRUE(runs[0].samples.empty());
+}
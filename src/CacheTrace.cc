@@ -15,17 +15,56 @@
 
 #include "CacheTrace.h"
 
+#include <stdio.h>
+
+#include <algorithm>
+
 namespace PerfUtils {
 
 /**
- * Construct a CacheTrace.
+ * Return eventList, after checking that a CacheTrace can hold that many
+ * counters.
+ */
+static const std::vector<PerfCounters::Event>&
+checkCounters(const std::vector<PerfCounters::Event>& eventList) {
+    if (eventList.empty() ||
+        eventList.size() > static_cast<size_t>(CacheTrace::MAX_COUNTERS))
+        PERFUTILS_DIE("CacheTrace needs between 1 and %d counters, not %lu",
+                      CacheTrace::MAX_COUNTERS, eventList.size());
+    return eventList;
+}
+
+/**
+ * Construct a CacheTrace, and program its counters for the calling thread.
+ *
+ * \param filename
+ *      The file that print appends the trace to, or NULL for stdout.
+ * \param eventList
+ *      The counters to record in each entry, at most MAX_COUNTERS of them;
+ *      for example LLC_MISSES, L1D_MISSES, DTLB_MISSES and INSTRUCTIONS.
+ *      The default is last-level cache misses alone.
  */
-CacheTrace::CacheTrace(const char* filename)
-    : events(), nextIndex(0), filename(filename) {
+CacheTrace::CacheTrace(const char* filename,
+                       const std::vector<PerfCounters::Event>& eventList)
+    : events(),
+      nextIndex(0),
+      filename(filename),
+      counterEvents(),
+      numCounters(static_cast<int>(eventList.size())),
+      counters(checkCounters(eventList)),
+      slots() {
     // Mark all of the events invalid.
     for (int i = 0; i < BUFFER_SIZE; i++) {
         events[i].message = NULL;
     }
+    for (int i = 0; i < numCounters; i++)
+        counterEvents[i] = eventList[i];
+    for (size_t i = 0; i < counters.getNumCounters(); i++) {
+        PerfCounters::Event event = counters.getEvent(i);
+        slots[i] = static_cast<int>(
+            std::find(eventList.begin(), eventList.end(), event) -
+            eventList.begin());
+    }
 }
 
 /**
@@ -34,7 +73,7 @@ CacheTrace::CacheTrace(const char* filename)
 CacheTrace::~CacheTrace() {}
 
 /**
- * Record an event in the trace.
+ * Record an event in the trace, with the current values of the counters.
  *
  * \param message
  *      A short human-readable string identifying what happened, or the
@@ -43,15 +82,39 @@ CacheTrace::~CacheTrace() {}
  *      in the time trace, so either the string must be static, or the caller
  *      must ensure that its contents will not change over its lifetime
  *      in the trace.
- * \param lastLevelMissCount
- *      Identifies the value of the Last Level Cache Miss counter at which
- *      the event occurred.
  */
 void
-CacheTrace::record(const char* message, uint64_t lastLevelMissCount) {
+CacheTrace::record(const char* message) {
+    uint64_t values[MAX_COUNTERS];
+    counters.read(values);
+    int i = nextIndex;
+    nextIndex = (i + 1) % BUFFER_SIZE;
+    for (int c = 0; c < MAX_COUNTERS; c++)
+        events[i].counts[c] = 0;
+    for (size_t c = 0; c < counters.getNumCounters(); c++)
+        events[i].counts[slots[c]] = values[c];
+    events[i].message = message;
+}
+
+/**
+ * Record an event in the trace with a count read by the caller, for
+ * example with Util::rdpmc from a counter programmed elsewhere. The count
+ * takes the place of the first counter, and the others read as 0.
+ *
+ * \param message
+ *      A short human-readable string identifying what happened; see the
+ *      other record method.
+ * \param count
+ *      Cumulative value of the caller's counter at which the event
+ *      occurred.
+ */
+void
+CacheTrace::record(const char* message, uint64_t count) {
     int i = nextIndex;
     nextIndex = (i + 1) % BUFFER_SIZE;
-    events[i].count = lastLevelMissCount;
+    events[i].counts[0] = count;
+    for (int c = 1; c < MAX_COUNTERS; c++)
+        events[i].counts[c] = 0;
     events[i].message = message;
 }
 
@@ -116,28 +179,37 @@ CacheTrace::printInternal(std::string* s) {
         }
     }
 
-    // Retrieve a "starting count" for the number of cache misses counted so we
-    // can print individual event counts relative to the starting count.
-    uint64_t start = events[i].count;
-    uint64_t prevCount = 0;
+    // Retrieve "starting counts" so we can print individual event counts
+    // relative to them.
+    uint64_t start[MAX_COUNTERS];
+    uint64_t previous[MAX_COUNTERS];
+    for (int c = 0; c < numCounters; c++) {
+        start[c] = events[i].counts[c];
+        previous[c] = 0;
+    }
 
     // Each iteration through this loop processes one event from the trace.
     do {
-        uint64_t miss = events[i].count - start;
+        std::string line;
+        for (int c = 0; c < numCounters; c++) {
+            uint64_t count = events[i].counts[c] - start[c];
+            char buffer[100];
+            snprintf(buffer, sizeof(buffer), "%s%8lu %s (+%6lu)",
+                     c == 0 ? "" : ", ", count,
+                     PerfCounters::eventName(counterEvents[c]),
+                     count - previous[c]);
+            line.append(buffer);
+            previous[c] = count;
+        }
         if (s != NULL) {
-            char buffer[200];
             if (s->length() != 0) {
                 s->append("\n");
             }
-            snprintf(buffer, sizeof(buffer), "%6lu misses (+%4lu misses): %s",
-                     miss, miss - prevCount, events[i].message);
-            s->append(buffer);
+            s->append(line + ": " + events[i].message);
         } else {
-            fprintf(output, "%6lu misses (+%4lu misses): %s\n", miss,
-                    miss - prevCount, events[i].message);
+            fprintf(output, "%s: %s\n", line.c_str(), events[i].message);
         }
         i = (i + 1) % BUFFER_SIZE;
-        prevCount = miss;
     } while ((i != nextIndex) && (events[i].message != NULL));
 
     if (output && output != stdout)
@@ -17,47 +17,70 @@
 #define PERFUTIL_CACHETRACE_H
 
 #include <string>
+#include <vector>
 #include "Atomic.h"
 #include "Cycles.h"
+#include "PerfCounters.h"
 #include "Util.h"
 
 namespace PerfUtils {
 
 /**
  * This class implements a circular buffer of entries, each of which
- * consists of a count of cache misses and a short descriptive string.
- * It's typically used to record counts at various points in an operation,
- * in order to find performance bottlenecks. It can record a trace relatively
- * efficiently, and then either return the trace either as a string or
- * print it to a file that is specified by the constructor.
+ * consists of the values of a few performance counters and a short
+ * descriptive string. It's typically used to record counts at various
+ * points in an operation, in order to find performance bottlenecks. It can
+ * record a trace relatively efficiently, and then either return the trace
+ * either as a string or print it to a file that is specified by the
+ * constructor. The printout shows, for each counter, both the count since
+ * the oldest entry and the count since the previous entry.
  *
- * This class is not synchronized, and is therefore not thread-safe.  Moreover,
- * it is meaningless to collect a trace including counters from multiple
- * threads, because the counters which are read by rdpmc are specific to each
- * CPU core.
+ * The counters are programmed by the constructor through PerfCounters, and
+ * read with rdpmc when the kernel allows it. They count only the thread
+ * that constructed the CacheTrace, wherever it runs, so entries should be
+ * recorded from that thread. Counters that cannot be opened (for example,
+ * on a virtual machine without a performance monitoring unit) read as 0;
+ * getError says why.
  *
- * Please read the note on rdpmc() carefully before using this class.
+ * This class is not synchronized, and is therefore not thread-safe.
  */
 class CacheTrace {
   public:
-    explicit CacheTrace(const char* filename);
+    // Largest number of counters in one trace. Most processors have four
+    // general-purpose counters per hyperthread, so more than this would be
+    // multiplexed by the kernel and could not be read with rdpmc.
+    static const int MAX_COUNTERS = 4;
+
+    explicit CacheTrace(const char* filename,
+                        const std::vector<PerfCounters::Event>& eventList =
+                            std::vector<PerfCounters::Event>(
+                                1, PerfCounters::LLC_MISSES));
     ~CacheTrace();
-    void record(const char* message,
-                uint64_t lastLevelMissCount = Util::rdpmc(0));
+    void record(const char* message);
+    void record(const char* message, uint64_t count);
 
     /**
-     * Simple wrapper for convenient serialized calls to readPmc, which will
-     * force earlier instructions to finish executing and prevent later
-     * instructions from executing until after the call to readPmc.
+     * Like record, but force earlier instructions to finish executing
+     * before the counters are read and prevent later instructions from
+     * executing until after they have been read.
      */
     void serialRecord(const char* message) {
-        record(message, Util::serialReadPmc(0));
+        Util::serialize();
+        record(message);
+        Util::serialize();
     }
     void print();
     std::string getTrace();
     void reset();
     static CacheTrace* getGlobalInstance();
 
+    /// Return the number of counters in each entry.
+    int getNumCounters() const { return numCounters; }
+
+    /// Return why some counters could not be opened, or an empty string
+    /// if all of them were.
+    const std::string& getError() const { return counters.getError(); }
+
   private:
     void printInternal(std::string* s);
 
@@ -65,9 +88,9 @@ class CacheTrace {
      * This structure holds one entry in the CacheTrace.
      */
     struct Event {
-        // Value of rdpmc output (cumulative count of last-level cache
-        // misses) when this event was recorded.
-        uint64_t count;
+        // Cumulative values of the counters, in the order given to the
+        // constructor, when this event was recorded.
+        uint64_t counts[MAX_COUNTERS];
 
         // Static string describing the event.  NULL means that this entry is
         // unused.
@@ -88,6 +111,15 @@ class CacheTrace {
     // write to stdout
     const char* filename;
 
+    // The counters that were asked for, and how many there are.
+    PerfCounters::Event counterEvents[MAX_COUNTERS];
+    int numCounters;
+
+    // The counters that could be opened; slots[i] is the index in
+    // Event::counts of the value that counters reports in position i.
+    PerfCounters counters;
+    int slots[MAX_COUNTERS];
+
     // Global instance
     static CacheTrace* globalTrace;
 };
@@ -0,0 +1,107 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "CacheTrace.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::CacheTrace;
+using PerfUtils::PerfCounters;
+
+TEST(CacheTraceTest, recordWithCount) {
+    CacheTrace trace(NULL);
+    EXPECT_EQ(1, trace.getNumCounters());
+    EXPECT_EQ("No cache trace events to print", trace.getTrace());
+    trace.record("first", 100);
+    trace.record("second", 150);
+    trace.record("third", 151);
+    EXPECT_EQ("       0 llc-misses (+     0): first\n"
+              "      50 llc-misses (+    50): second\n"
+              "      51 llc-misses (+     1): third",
+              trace.getTrace());
+
+    trace.reset();
+    EXPECT_EQ("No cache trace events to print", trace.getTrace());
+}
+
+TEST(CacheTraceTest, recordCounters) {
+    // Software events, so that this works without a hardware performance
+    // monitoring unit.
+    CacheTrace trace(NULL, {PerfCounters::TASK_CLOCK,
+                            PerfCounters::PAGE_FAULTS});
+    // perf_event_open may be blocked altogether, for example by a
+    // container's seccomp profile.
+    if (!trace.getError().empty())
+        return;
+    EXPECT_EQ(2, trace.getNumCounters());
+    trace.record("start");
+    const size_t size = 64 << 20;
+    // The volatile pointer keeps the compiler from eliding the memset.
+    char* volatile memory = static_cast<char*>(malloc(size));
+    memset(memory, 1, size);
+    trace.serialRecord("touched");
+    free(memory);
+
+    std::string output = trace.getTrace();
+    EXPECT_EQ(0U, output.find("       0 task-clock (+     0),        0 "
+                              "page-faults (+     0): start\n"));
+    size_t second = output.find('\n') + 1;
+    uint64_t taskClock, taskClockDelta, faults, faultsDelta;
+    char message[20];
+    ASSERT_EQ(5, sscanf(output.c_str() + second,
+                        "%" SCNu64 " task-clock (+ %" SCNu64 "), %" SCNu64
+                        " page-faults (+ %" SCNu64 "): %19s",
+                        &taskClock, &taskClockDelta, &faults, &faultsDelta,
+                        message));
+    EXPECT_LT(0U, taskClock);
+    EXPECT_EQ(taskClock, taskClockDelta);
+    EXPECT_LT(0U, faults);
+    EXPECT_EQ(faults, faultsDelta);
+    EXPECT_STREQ("touched", message);
+}
+
+TEST(CacheTraceTest, missingCounters) {
+    // Whether or not the hardware counter can be opened, each value stays
+    // in the column of the event it belongs to.
+    CacheTrace trace(NULL, {PerfCounters::INSTRUCTIONS,
+                            PerfCounters::TASK_CLOCK});
+    if (trace.getError().find("task-clock") != std::string::npos)
+        return;
+    trace.record("start");
+    volatile uint64_t sum = 0;
+    for (int i = 0; i < 1000000; i++)
+        sum += i;
+    trace.record("end");
+    std::string output = trace.getTrace();
+    size_t second = output.find('\n') + 1;
+    uint64_t instructions, taskClock;
+    ASSERT_EQ(2, sscanf(output.c_str() + second,
+                        "%" SCNu64 " instructions (+ %*u), %" SCNu64
+                        " task-clock",
+                        &instructions, &taskClock));
+    EXPECT_LT(0U, taskClock);
+    if (trace.getError().empty())
+        EXPECT_LT(1000000U, instructions);
+    else
+        EXPECT_EQ(0U, instructions);
+}
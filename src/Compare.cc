@@ -0,0 +1,343 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Compare.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+
+#include "SampleFile.h"
+#include "Util.h"
+
+namespace PerfUtils {
+
+/**
+ * A sorted, run-length encoded view of a set of samples, which can be built
+ * from either raw samples or a Histogram. Both the bootstrap and the rank
+ * test work from this.
+ */
+struct SortedSamples {
+    // Distinct values in increasing order.
+    std::vector<uint64_t> values;
+
+    // cumulative[i] is the number of samples no larger than values[i].
+    std::vector<uint64_t> cumulative;
+
+    /// Return the total number of samples.
+    uint64_t count() const {
+        return cumulative.empty() ? 0 : cumulative.back();
+    }
+
+    /// Return the sample of the given zero-based rank.
+    uint64_t valueAtRank(uint64_t rank) const {
+        return values[std::upper_bound(cumulative.begin(), cumulative.end(),
+                                       rank) -
+                      cumulative.begin()];
+    }
+
+    /// Return the sample at the given quantile, using the same rank
+    /// convention as computeStatistics.
+    uint64_t valueAtQuantile(double quantile) const {
+        uint64_t n = count();
+        uint64_t rank =
+            static_cast<uint64_t>(static_cast<double>(n) * quantile);
+        return valueAtRank(rank < n ? rank : n - 1);
+    }
+};
+
+/**
+ * Build a SortedSamples from raw samples, without modifying them.
+ */
+static SortedSamples
+makeSortedSamples(const uint64_t* samples, size_t count) {
+    std::vector<uint64_t> copy(samples, samples + count);
+    std::sort(copy.begin(), copy.end());
+    SortedSamples sorted;
+    for (size_t i = 0; i < count; i++) {
+        if (i + 1 == count || copy[i + 1] != copy[i]) {
+            sorted.values.push_back(copy[i]);
+            sorted.cumulative.push_back(i + 1);
+        }
+    }
+    return sorted;
+}
+
+/**
+ * Build a SortedSamples from the slots of a histogram.
+ */
+static SortedSamples
+makeSortedSamples(const Histogram& histogram) {
+    SortedSamples sorted;
+    histogram.getBuckets(&sorted.values, &sorted.cumulative);
+    for (size_t i = 1; i < sorted.cumulative.size(); i++)
+        sorted.cumulative[i] += sorted.cumulative[i - 1];
+    return sorted;
+}
+
+/**
+ * Return the relative change from baseline to candidate.
+ */
+static double
+relativeChange(uint64_t baseline, uint64_t candidate) {
+    return (static_cast<double>(candidate) - static_cast<double>(baseline)) /
+           static_cast<double>(baseline > 0 ? baseline : 1);
+}
+
+/**
+ * Draw the value at a quantile of a bootstrap resample of a set of samples,
+ * without building the resample. The k-th smallest of n samples drawn with
+ * replacement from the empirical distribution is the empirical quantile at
+ * the k-th smallest of n uniform variables, which is Beta(k, n + 1 - k)
+ * distributed. This makes each replicate O(log n) instead of O(n).
+ */
+static uint64_t
+bootstrapQuantile(const SortedSamples& sorted, double quantile,
+                  std::mt19937_64& generator) {
+    uint64_t n = sorted.count();
+    uint64_t rank = static_cast<uint64_t>(static_cast<double>(n) * quantile);
+    double k = static_cast<double>((rank < n ? rank : n - 1) + 1);
+    std::gamma_distribution<double> a(k, 1.0);
+    std::gamma_distribution<double> b(static_cast<double>(n) + 1 - k, 1.0);
+    double x = a(generator);
+    double u = x / (x + b(generator));
+    uint64_t resampledRank =
+        static_cast<uint64_t>(u * static_cast<double>(n));
+    return sorted.valueAtRank(resampledRank < n ? resampledRank : n - 1);
+}
+
+/**
+ * Do the work of the compare variants.
+ */
+static Comparison
+compareSortedSamples(const SortedSamples& baseline,
+                     const SortedSamples& candidate,
+                     const CompareOptions& options) {
+    Comparison result = Comparison();
+    result.baselineCount = baseline.count();
+    result.candidateCount = candidate.count();
+    result.pValue = 1;
+    result.probabilitySlower = 0.5;
+    result.verdict = NOISE;
+    if (options.resamples <= 0)
+        PERFUTILS_DIE("compare: resamples must be positive, not %d",
+                      options.resamples);
+    if (result.baselineCount == 0 || result.candidateCount == 0)
+        return result;
+
+    // Percentile bootstrap confidence interval of the relative change at
+    // each quantile.
+    std::mt19937_64 generator(options.seed);
+    std::vector<double> replicates(options.resamples);
+    bool anyRegression = false;
+    bool anyImprovement = false;
+    for (size_t i = 0; i < options.quantiles.size(); i++) {
+        QuantileChange change;
+        change.quantile = options.quantiles[i];
+        change.baseline = baseline.valueAtQuantile(change.quantile);
+        change.candidate = candidate.valueAtQuantile(change.quantile);
+        change.change = relativeChange(change.baseline, change.candidate);
+        for (int r = 0; r < options.resamples; r++) {
+            uint64_t b =
+                bootstrapQuantile(baseline, change.quantile, generator);
+            uint64_t c =
+                bootstrapQuantile(candidate, change.quantile, generator);
+            replicates[r] = relativeChange(b, c);
+        }
+        std::sort(replicates.begin(), replicates.end());
+        double tail = (1 - options.confidence) / 2;
+        size_t low = static_cast<size_t>(tail * options.resamples);
+        size_t high = static_cast<size_t>((1 - tail) * options.resamples);
+        high = high < replicates.size() ? high : replicates.size() - 1;
+        change.lower = replicates[low];
+        change.upper = replicates[high];
+        if (change.lower > options.threshold) {
+            change.verdict = REGRESSION;
+            anyRegression = true;
+        } else if (change.upper < -options.threshold) {
+            change.verdict = IMPROVEMENT;
+            anyImprovement = true;
+        } else {
+            change.verdict = NOISE;
+        }
+        result.quantiles.push_back(change);
+    }
+
+    // Mann-Whitney U test: rank the two runs together, giving tied samples
+    // the average of their ranks.
+    double candidateRankSum = 0;
+    double tieCorrection = 0;
+    double position = 0;
+    size_t i = 0, j = 0;
+    uint64_t previousB = 0, previousC = 0;
+    while (i < baseline.values.size() || j < candidate.values.size()) {
+        uint64_t value;
+        if (j == candidate.values.size() ||
+            (i < baseline.values.size() &&
+             baseline.values[i] < candidate.values[j])) {
+            value = baseline.values[i];
+        } else {
+            value = candidate.values[j];
+        }
+        double inBaseline = 0, inCandidate = 0;
+        if (i < baseline.values.size() && baseline.values[i] == value) {
+            inBaseline = static_cast<double>(baseline.cumulative[i] -
+                                             previousB);
+            previousB = baseline.cumulative[i++];
+        }
+        if (j < candidate.values.size() && candidate.values[j] == value) {
+            inCandidate = static_cast<double>(candidate.cumulative[j] -
+                                              previousC);
+            previousC = candidate.cumulative[j++];
+        }
+        double tied = inBaseline + inCandidate;
+        candidateRankSum += inCandidate * (position + (tied + 1) / 2);
+        tieCorrection += tied * tied * tied - tied;
+        position += tied;
+    }
+    double n1 = static_cast<double>(result.baselineCount);
+    double n2 = static_cast<double>(result.candidateCount);
+    double n = n1 + n2;
+    result.u = candidateRankSum - n2 * (n2 + 1) / 2;
+    result.probabilitySlower = result.u / (n1 * n2);
+    double variance =
+        n1 * n2 / 12 * ((n + 1) - tieCorrection / (n * (n - 1)));
+    if (variance > 0) {
+        double deviation = fabs(result.u - n1 * n2 / 2) - 0.5;
+        double z = (deviation > 0 ? deviation : 0) / sqrt(variance);
+        result.pValue = erfc(z / sqrt(2.0));
+    }
+
+    double medianChange = relativeChange(baseline.valueAtQuantile(0.5),
+                                         candidate.valueAtQuantile(0.5));
+    // A regressed quantile outweighs everything else, including a U test
+    // that shows the candidate faster overall: a slower tail is not made
+    // up for by a faster median.
+    bool significant = result.pValue < options.alpha;
+    if (anyRegression || (significant && result.probabilitySlower > 0.5 &&
+                          medianChange > options.threshold)) {
+        result.verdict = REGRESSION;
+    } else if (anyImprovement ||
+               (significant && result.probabilitySlower < 0.5 &&
+                medianChange < -options.threshold)) {
+        result.verdict = IMPROVEMENT;
+    }
+    return result;
+}
+
+/**
+ * Compare two runs of raw samples; smaller samples are better. The runs are
+ * compared at each of options.quantiles with a bootstrap confidence
+ * interval, and as a whole with the Mann-Whitney U test. The samples are
+ * not modified.
+ *
+ * \param baseline
+ *      Samples from the reference run.
+ * \param baselineCount
+ *      Number of samples in baseline.
+ * \param candidate
+ *      Samples from the run being evaluated.
+ * \param candidateCount
+ *      Number of samples in candidate.
+ * \param options
+ *      Quantiles, confidence level and thresholds to use.
+ */
+Comparison
+compare(const uint64_t* baseline, size_t baselineCount,
+        const uint64_t* candidate, size_t candidateCount,
+        const CompareOptions& options) {
+    return compareSortedSamples(makeSortedSamples(baseline, baselineCount),
+                                makeSortedSamples(candidate, candidateCount),
+                                options);
+}
+
+/**
+ * Compare two runs recorded in histograms. Each recorded value is treated
+ * as the value valueAtQuantile reports for its slot, so the results are
+ * accurate to the precision of the histograms.
+ */
+Comparison
+compare(const Histogram& baseline, const Histogram& candidate,
+        const CompareOptions& options) {
+    return compareSortedSamples(makeSortedSamples(baseline),
+                                makeSortedSamples(candidate), options);
+}
+
+/**
+ * Compare two runs saved with SampleFile::write (or printStatistics with
+ * BINARY_SAMPLES). The files must record the same unit.
+ */
+Comparison
+compareFiles(const char* baselinePath, const char* candidatePath,
+             const CompareOptions& options) {
+    SampleFile baseline(baselinePath);
+    SampleFile candidate(candidatePath);
+    if (baseline.getUnit() != candidate.getUnit()) {
+        PERFUTILS_DIE("compareFiles: %s is in %s but %s is in %s",
+                      baselinePath, baseline.getUnit().c_str(),
+                      candidatePath, candidate.getUnit().c_str());
+    }
+    return compare(baseline.getSamples(), baseline.getCount(),
+                   candidate.getSamples(), candidate.getCount(), options);
+}
+
+/**
+ * Return a lower-case name for a verdict, as used by printComparison.
+ */
+const char*
+verdictName(Verdict verdict) {
+    switch (verdict) {
+        case IMPROVEMENT:
+            return "improvement";
+        case REGRESSION:
+            return "regression";
+        default:
+            return "noise";
+    }
+}
+
+/**
+ * Print the CSV header for the rows printed by printComparison.
+ */
+void
+printComparisonHeader(FILE* out) {
+    fputs("Benchmark,Statistic,Baseline,Candidate,Change,Lower,Upper,"
+          "PValue,Verdict\n", out);
+}
+
+/**
+ * Print a comparison in CSV format: one row per quantile with the relative
+ * change and its confidence interval, then an Overall row with the sample
+ * counts, the p-value of the U test and the overall verdict. Call
+ * printComparisonHeader first to print the column names.
+ */
+void
+printComparison(const Comparison& comparison, const char* label, FILE* out) {
+    for (size_t i = 0; i < comparison.quantiles.size(); i++) {
+        const QuantileChange& change = comparison.quantiles[i];
+        fprintf(out, "%s,P%g,%lu,%lu,%+.2f%%,%+.2f%%,%+.2f%%,,%s\n", label,
+                change.quantile * 100, change.baseline, change.candidate,
+                change.change * 100, change.lower * 100, change.upper * 100,
+                verdictName(change.verdict));
+    }
+    fprintf(out, "%s,Overall,%lu,%lu,,,,%.4g,%s\n", label,
+            comparison.baselineCount, comparison.candidateCount,
+            comparison.pValue, verdictName(comparison.verdict));
+}
+
+}  // namespace PerfUtils
@@ -0,0 +1,134 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PERFUTILS_COMPARE_H
+#define PERFUTILS_COMPARE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "Histogram.h"
+
+namespace PerfUtils {
+
+/**
+ * The outcome of comparing a candidate run against a baseline, for samples
+ * where smaller is better (such as latencies).
+ */
+enum Verdict {
+    // No change beyond the noise threshold could be demonstrated.
+    NOISE,
+    // The candidate is faster.
+    IMPROVEMENT,
+    // The candidate is slower.
+    REGRESSION
+};
+
+/**
+ * Parameters for compare().
+ */
+struct CompareOptions {
+    CompareOptions()
+        : quantiles({0.5, 0.9, 0.99, 0.999}),
+          confidence(0.95),
+          resamples(2000),
+          threshold(0.02),
+          alpha(0.01),
+          seed(1) {}
+
+    // Quantiles at which to compare the runs.
+    std::vector<double> quantiles;
+
+    // Coverage of the bootstrap confidence intervals.
+    double confidence;
+
+    // Number of bootstrap resamples per quantile; must be positive.
+    int resamples;
+
+    // Smallest relative change that counts; for example 0.02 means that a
+    // quantile must move by more than 2% to be reported as a change.
+    double threshold;
+
+    // Significance level for the Mann-Whitney U test.
+    double alpha;
+
+    // Seed for the bootstrap, so that results are reproducible.
+    uint64_t seed;
+};
+
+/**
+ * How one quantile changed between the baseline and the candidate.
+ */
+struct QuantileChange {
+    double quantile;
+    uint64_t baseline;
+    uint64_t candidate;
+
+    // Relative change, (candidate - baseline) / baseline, with its bootstrap
+    // confidence interval.
+    double change;
+    double lower;
+    double upper;
+
+    // REGRESSION if the whole interval lies above +threshold, IMPROVEMENT if
+    // it lies below -threshold, and NOISE otherwise.
+    Verdict verdict;
+};
+
+/**
+ * The result of compare().
+ */
+struct Comparison {
+    uint64_t baselineCount;
+    uint64_t candidateCount;
+    std::vector<QuantileChange> quantiles;
+
+    // Mann-Whitney U statistic of the candidate, and the probability that a
+    // random candidate sample is slower than a random baseline sample (ties
+    // count half); 0.5 means no shift.
+    double u;
+    double probabilitySlower;
+
+    // Two-sided p-value of the U test, from the normal approximation with a
+    // correction for ties.
+    double pValue;
+
+    // Overall verdict: REGRESSION if any quantile regressed, or if the U
+    // test is significant and the candidate is slower by more than the
+    // threshold at the median; IMPROVEMENT likewise; NOISE otherwise.
+    // REGRESSION takes precedence, so a run with a slower tail is a
+    // regression even if its median improved and the U test finds it
+    // faster overall.
+    Verdict verdict;
+};
+
+Comparison compare(const uint64_t* baseline, size_t baselineCount,
+                   const uint64_t* candidate, size_t candidateCount,
+                   const CompareOptions& options = CompareOptions());
+Comparison compare(const Histogram& baseline, const Histogram& candidate,
+                   const CompareOptions& options = CompareOptions());
+Comparison compareFiles(const char* baselinePath, const char* candidatePath,
+                        const CompareOptions& options = CompareOptions());
+const char* verdictName(Verdict verdict);
+void printComparisonHeader(FILE* out = stdout);
+void printComparison(const Comparison& comparison, const char* label,
+                     FILE* out = stdout);
+
+}  // namespace PerfUtils
+
+#endif  // PERFUTILS_COMPARE_H
@@ -0,0 +1,161 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Compare.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SampleFile.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::Comparison;
+using PerfUtils::CompareOptions;
+using PerfUtils::Histogram;
+
+/**
+ * Generate count latency-like samples, scaled by factor.
+ */
+static std::vector<uint64_t>
+latencies(size_t count, double factor, uint64_t seed) {
+    std::mt19937_64 generator(seed);
+    std::lognormal_distribution<double> latency(7.0, 0.5);
+    std::vector<uint64_t> samples(count);
+    for (size_t i = 0; i < count; i++)
+        samples[i] = static_cast<uint64_t>(latency(generator) * factor);
+    return samples;
+}
+
+TEST(CompareTest, sameDistributionIsNoise) {
+    std::vector<uint64_t> baseline = latencies(20000, 1.0, 1);
+    std::vector<uint64_t> candidate = latencies(20000, 1.0, 2);
+    Comparison result = PerfUtils::compare(baseline.data(), baseline.size(),
+                                           candidate.data(),
+                                           candidate.size());
+    EXPECT_EQ(PerfUtils::NOISE, result.verdict);
+    EXPECT_GT(result.pValue, 0.01);
+    EXPECT_NEAR(0.5, result.probabilitySlower, 0.02);
+    ASSERT_EQ(4U, result.quantiles.size());
+    for (size_t i = 0; i < result.quantiles.size(); i++) {
+        EXPECT_LE(result.quantiles[i].lower, result.quantiles[i].change);
+        EXPECT_GE(result.quantiles[i].upper, result.quantiles[i].change);
+    }
+    EXPECT_LT(result.quantiles[0].lower, 0);
+    EXPECT_GT(result.quantiles[0].upper, 0);
+}
+
+TEST(CompareTest, shiftsAreDetected) {
+    std::vector<uint64_t> baseline = latencies(20000, 1.0, 1);
+    std::vector<uint64_t> slower = latencies(20000, 1.2, 2);
+    Comparison result = PerfUtils::compare(baseline.data(), baseline.size(),
+                                           slower.data(), slower.size());
+    EXPECT_EQ(PerfUtils::REGRESSION, result.verdict);
+    EXPECT_LT(result.pValue, 1e-6);
+    EXPECT_GT(result.probabilitySlower, 0.5);
+    EXPECT_EQ(PerfUtils::REGRESSION, result.quantiles[0].verdict);
+    EXPECT_NEAR(0.2, result.quantiles[0].change, 0.05);
+
+    result = PerfUtils::compare(slower.data(), slower.size(),
+                                baseline.data(), baseline.size());
+    EXPECT_EQ(PerfUtils::IMPROVEMENT, result.verdict);
+    EXPECT_EQ(PerfUtils::IMPROVEMENT, result.quantiles[0].verdict);
+
+    // The same comparison from histograms.
+    Histogram baselineHistogram, slowerHistogram;
+    for (size_t i = 0; i < baseline.size(); i++) {
+        baselineHistogram.record(baseline[i]);
+        slowerHistogram.record(slower[i]);
+    }
+    result = PerfUtils::compare(baselineHistogram, slowerHistogram);
+    EXPECT_EQ(PerfUtils::REGRESSION, result.verdict);
+    EXPECT_EQ(20000U, result.candidateCount);
+    EXPECT_LT(result.pValue, 1e-6);
+}
+
+TEST(CompareTest, tailRegressionOutweighsImprovement) {
+    // Faster at the median, but one sample in fifty is ten times slower.
+    std::vector<uint64_t> baseline = latencies(20000, 1.0, 1);
+    std::vector<uint64_t> candidate = latencies(20000, 0.8, 2);
+    for (size_t i = 0; i < candidate.size(); i += 50)
+        candidate[i] *= 10;
+    Comparison result = PerfUtils::compare(baseline.data(), baseline.size(),
+                                           candidate.data(),
+                                           candidate.size());
+    EXPECT_EQ(PerfUtils::IMPROVEMENT, result.quantiles[0].verdict);
+    EXPECT_EQ(PerfUtils::REGRESSION, result.quantiles[2].verdict);
+    EXPECT_LT(result.pValue, 1e-6);
+    EXPECT_LT(result.probabilitySlower, 0.5);
+    EXPECT_EQ(PerfUtils::REGRESSION, result.verdict);
+}
+
+TEST(CompareTest, badResamples) {
+    uint64_t samples[] = {1, 2, 3};
+    CompareOptions options;
+    options.resamples = -1;
+    EXPECT_DEATH(PerfUtils::compare(samples, 3, samples, 3, options),
+                 "resamples must be positive");
+}
+
+TEST(CompareTest, mannWhitney) {
+    uint64_t baseline[] = {1, 2, 3};
+    uint64_t candidate[] = {4, 5, 6};
+    Comparison result = PerfUtils::compare(baseline, 3, candidate, 3);
+    EXPECT_DOUBLE_EQ(9, result.u);
+    EXPECT_DOUBLE_EQ(1, result.probabilitySlower);
+    EXPECT_NEAR(0.0809, result.pValue, 1e-4);
+
+    // Complete ties: half of each pair counts.
+    uint64_t same[] = {7, 7, 7, 7};
+    result = PerfUtils::compare(same, 4, same, 4);
+    EXPECT_DOUBLE_EQ(8, result.u);
+    EXPECT_EQ(1, result.pValue);
+    EXPECT_EQ(PerfUtils::NOISE, result.verdict);
+}
+
+TEST(CompareTest, compareFilesAndPrint) {
+    char dir[] = "/tmp/CompareTest_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    std::string before = std::string(dir) + "/before";
+    std::string after = std::string(dir) + "/after";
+    uint64_t baseline[] = {100, 100, 100, 100};
+    uint64_t candidate[] = {200, 200, 200, 200};
+    PerfUtils::SampleFile::write(before.c_str(), "x", "ns", 0, baseline, 4);
+    PerfUtils::SampleFile::write(after.c_str(), "x", "ns", 0, candidate, 4);
+
+    CompareOptions options;
+    options.quantiles = {0.5};
+    Comparison result =
+        PerfUtils::compareFiles(before.c_str(), after.c_str(), options);
+    EXPECT_EQ(PerfUtils::REGRESSION, result.verdict);
+
+    testing::internal::CaptureStdout();
+    PerfUtils::printComparisonHeader();
+    PerfUtils::printComparison(result, "files");
+    std::string output = testing::internal::GetCapturedStdout();
+    EXPECT_EQ("Benchmark,Statistic,Baseline,Candidate,Change,Lower,Upper,"
+              "PValue,Verdict\n"
+              "files,P50,100,200,+100.00%,+100.00%,+100.00%,,regression\n"
+              "files,Overall,4,4,,,,0.01312,regression\n",
+              output);
+
+    unlink(before.c_str());
+    unlink(after.c_str());
+    rmdir(dir);
+}
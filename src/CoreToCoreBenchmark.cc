@@ -0,0 +1,106 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * This program measures the latency of handing a cache line between every
+ * ordered pair of usable cores, as reported by getAllUseableCores (or, if
+ * that finds none, the cores this process may run on). The results can be
+ * used to decide where to place threads that communicate.
+ *
+ * Usage: CoreToCoreBenchmark [numRoundTrips]
+ *
+ * Each pair is measured with coreToCoreLatency using numRoundTrips round
+ * trips (default 100000). The output is two CSV matrices of one-way
+ * latencies in nanoseconds, the medians and then the 99th percentiles,
+ * separated by a blank line. Rows are the cores that time the round trips
+ * and columns the cores that answer; the diagonal is left empty.
+ */
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "Cycles.h"
+#include "Perf.h"
+#include "Util.h"
+
+using PerfUtils::Cycles;
+
+/**
+ * Print one of the latency matrices.
+ *
+ * \param title
+ *      Printed in the top-left cell.
+ * \param cores
+ *      The cores that label the rows and columns.
+ * \param latencies
+ *      latencies[i][j] is the latency from cores[i] to cores[j], in cycles.
+ */
+static void
+printMatrix(const char* title, const std::vector<int>& cores,
+            const std::vector<std::vector<uint64_t>>& latencies) {
+    printf("%s", title);
+    for (size_t j = 0; j < cores.size(); j++)
+        printf(",%d", cores[j]);
+    printf("\n");
+    for (size_t i = 0; i < cores.size(); i++) {
+        printf("%d", cores[i]);
+        for (size_t j = 0; j < cores.size(); j++) {
+            if (i == j)
+                printf(",");
+            else
+                printf(",%.1f", Cycles::toSeconds(latencies[i][j]) * 1e9);
+        }
+        printf("\n");
+    }
+}
+
+int
+main(int argc, char** argv) {
+    int numRoundTrips = 100000;
+    if (argc > 1)
+        numRoundTrips = atoi(argv[1]);
+
+    std::vector<int> cores = PerfUtils::Util::getAllUseableCores();
+    if (cores.empty()) {
+        cpu_set_t allowed = PerfUtils::Util::getCpuAffinity();
+        for (int core = 0; core < CPU_SETSIZE; core++) {
+            if (CPU_ISSET(core, &allowed))
+                cores.push_back(core);
+        }
+    }
+
+    size_t numCores = cores.size();
+    std::vector<std::vector<uint64_t>> medians(
+        numCores, std::vector<uint64_t>(numCores));
+    std::vector<std::vector<uint64_t>> tails(
+        numCores, std::vector<uint64_t>(numCores));
+    for (size_t i = 0; i < numCores; i++) {
+        for (size_t j = 0; j < numCores; j++) {
+            if (i == j)
+                continue;
+            Statistics stats = PerfUtils::coreToCoreLatency(
+                cores[i], cores[j], numRoundTrips);
+            medians[i][j] = stats.median;
+            tails[i][j] = stats.P99;
+        }
+    }
+
+    printMatrix("Median", cores, medians);
+    printf("\n");
+    printMatrix("P99", cores, tails);
+}
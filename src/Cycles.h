@@ -57,6 +57,57 @@ class Cycles {
         return (((uint64_t)hi << 32) | lo);
     }
 
+    /**
+     * Like rdtscp, but also return the contents of the TSC_AUX register,
+     * which Linux sets to the number of the core the thread runs on (in
+     * the low 12 bits) and its NUMA node (in the bits above). Comparing
+     * it before and after a measurement shows whether the thread moved.
+     */
+    static __inline __attribute__((always_inline)) uint64_t rdtscp(
+        uint32_t* aux) {
+        uint32_t lo, hi;
+        __asm__ __volatile__("rdtscp" : "=a"(lo), "=d"(hi), "=c"(*aux));
+#if TESTING
+        if (mockTscValue)
+            return mockTscValue;
+#endif
+        return (((uint64_t)hi << 32) | lo);
+    }
+
+    /**
+     * Return the current value of the fine-grain CPU cycle counter after
+     * waiting for all earlier instructions to complete (LFENCE; RDTSC).
+     * This is the preferred way to read the counter at the start of a
+     * timed region, since work before the read cannot leak into it.
+     */
+    static __inline __attribute__((always_inline)) uint64_t rdtscFenced() {
+#if TESTING
+        if (mockTscValue)
+            return mockTscValue;
+#endif
+        uint32_t lo, hi;
+        __asm__ __volatile__("lfence\n\trdtsc" : "=a"(lo), "=d"(hi) : :
+                             "memory");
+        return (((uint64_t)hi << 32) | lo);
+    }
+
+    /**
+     * Return the current value of the fine-grain CPU cycle counter, and
+     * prevent later instructions from starting until it has been read
+     * (RDTSCP; LFENCE). This is the preferred way to read the counter at
+     * the end of a timed region.
+     */
+    static __inline __attribute__((always_inline)) uint64_t rdtscpFenced() {
+#if TESTING
+        if (mockTscValue)
+            return mockTscValue;
+#endif
+        uint32_t lo, hi;
+        __asm__ __volatile__("rdtscp\n\tlfence" : "=a"(lo), "=d"(hi) : :
+                             "%rcx", "memory");
+        return (((uint64_t)hi << 32) | lo);
+    }
+
     static __inline __attribute__((always_inline)) double perSecond() {
         return getCyclesPerSec();
     }
@@ -0,0 +1,460 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Histogram.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "Util.h"
+
+namespace PerfUtils {
+
+/**
+ * Construct an empty Histogram.
+ *
+ * \param significantDigits
+ *      Number of significant decimal digits to preserve for every recorded
+ *      value; must be between 1 and 5. Memory use grows by roughly a factor
+ *      of ten for each additional digit.
+ * \param highestTrackableValue
+ *      Largest value that needs to be recorded with full precision. Lowering
+ *      this from the default reduces the memory used.
+ */
+Histogram::Histogram(int significantDigits, uint64_t highestTrackableValue)
+    : significantDigits(significantDigits),
+      highestTrackableValue(highestTrackableValue),
+      subBucketHalfCountMagnitude(0),
+      subBucketHalfCount(0),
+      subBucketMask(0),
+      numCounts(0),
+      counts(NULL),
+      totalCount(0),
+      min(UINT64_MAX),
+      max(0) {
+    if (significantDigits < 1 || significantDigits > 5) {
+        PERFUTILS_DIE("Histogram supports 1 to 5 significant digits, not %d",
+                      significantDigits);
+    }
+
+    // Every value below this needs its own sub-bucket to guarantee the
+    // requested precision for all values.
+    uint64_t largestValueWithSingleUnitResolution =
+        2 * static_cast<uint64_t>(pow(10, significantDigits));
+    int subBucketCountMagnitude = static_cast<int>(
+        ceil(log2(static_cast<double>(largestValueWithSingleUnitResolution))));
+    subBucketHalfCountMagnitude = subBucketCountMagnitude - 1;
+    subBucketHalfCount = 1UL << subBucketHalfCountMagnitude;
+    subBucketMask = (1UL << subBucketCountMagnitude) - 1;
+
+    numCounts = countsIndex(highestTrackableValue) + 1;
+    counts = reinterpret_cast<uint64_t*>(calloc(numCounts, sizeof(uint64_t)));
+}
+
+/**
+ * Construct a copy of another Histogram, with the same precision, range and
+ * recorded values.
+ */
+Histogram::Histogram(const Histogram& other)
+    : significantDigits(other.significantDigits),
+      highestTrackableValue(other.highestTrackableValue),
+      subBucketHalfCountMagnitude(other.subBucketHalfCountMagnitude),
+      subBucketHalfCount(other.subBucketHalfCount),
+      subBucketMask(other.subBucketMask),
+      numCounts(other.numCounts),
+      counts(NULL),
+      totalCount(other.totalCount),
+      min(other.min),
+      max(other.max) {
+    counts = reinterpret_cast<uint64_t*>(malloc(numCounts * sizeof(uint64_t)));
+    memcpy(counts, other.counts, numCounts * sizeof(uint64_t));
+}
+
+/**
+ * Replace the contents of this Histogram with a copy of another.
+ */
+Histogram&
+Histogram::operator=(const Histogram& other) {
+    if (this == &other)
+        return *this;
+    if (numCounts != other.numCounts) {
+        free(counts);
+        counts = reinterpret_cast<uint64_t*>(
+            malloc(other.numCounts * sizeof(uint64_t)));
+    }
+    significantDigits = other.significantDigits;
+    highestTrackableValue = other.highestTrackableValue;
+    subBucketHalfCountMagnitude = other.subBucketHalfCountMagnitude;
+    subBucketHalfCount = other.subBucketHalfCount;
+    subBucketMask = other.subBucketMask;
+    numCounts = other.numCounts;
+    memcpy(counts, other.counts, numCounts * sizeof(uint64_t));
+    totalCount = other.totalCount;
+    min = other.min;
+    max = other.max;
+    return *this;
+}
+
+Histogram::~Histogram() {
+    free(counts);
+}
+
+/**
+ * Record a latency measured by a client that issues requests at a fixed
+ * rate but waits for each response before sending the next, correcting for
+ * coordinated omission: while one request stalled, the requests that
+ * should have been sent at each expectedInterval would each have waited
+ * for it too, so their latencies (value - expectedInterval,
+ * value - 2 * expectedInterval, and so on down to expectedInterval) are
+ * recorded as well. This is the same correction that HdrHistogram makes.
+ *
+ * \param value
+ *      The measured latency.
+ * \param expectedInterval
+ *      The time between requests under the intended load, in the same unit
+ *      as value. If 0, no correction is made.
+ */
+void
+Histogram::recordWithExpectedInterval(uint64_t value,
+                                      uint64_t expectedInterval) {
+    record(value);
+    if (expectedInterval == 0 || value <= expectedInterval)
+        return;
+    for (uint64_t missing = value - expectedInterval;
+         missing >= expectedInterval; missing -= expectedInterval)
+        record(missing);
+}
+
+/**
+ * Add all the values recorded in another Histogram into this one. The other
+ * Histogram may have a different precision or range, in which case its
+ * values are re-recorded at this Histogram's precision.
+ */
+void
+Histogram::add(const Histogram& other) {
+    if (other.totalCount == 0)
+        return;
+    if (other.numCounts == numCounts &&
+        other.subBucketHalfCountMagnitude == subBucketHalfCountMagnitude) {
+        for (size_t i = 0; i < numCounts; i++)
+            counts[i] += other.counts[i];
+        totalCount += other.totalCount;
+    } else {
+        // Re-recording lowers min to the start of the other's slot, which
+        // may be below any value actually recorded, so restore it below.
+        uint64_t savedMin = min;
+        for (size_t i = 0; i < other.numCounts; i++) {
+            if (other.counts[i] != 0)
+                record(other.valueFromIndex(i), other.counts[i]);
+        }
+        min = savedMin;
+    }
+    if (other.min < min)
+        min = other.min;
+    if (other.max > max)
+        max = other.max;
+}
+
+/**
+ * Discard all recorded values.
+ */
+void
+Histogram::reset() {
+    memset(counts, 0, numCounts * sizeof(uint64_t));
+    totalCount = 0;
+    min = UINT64_MAX;
+    max = 0;
+}
+
+/**
+ * Return the smallest value that is recorded in the same slot as value.
+ */
+uint64_t
+Histogram::lowestEquivalentValue(uint64_t value) const {
+    int bucket = bucketIndex(value);
+    return (value >> bucket) << bucket;
+}
+
+/**
+ * Return the largest value that is recorded in the same slot as value.
+ */
+uint64_t
+Histogram::highestEquivalentValue(uint64_t value) const {
+    int bucket = bucketIndex(value);
+    return lowestEquivalentValue(value) + ((1UL << bucket) - 1);
+}
+
+/**
+ * Return the smallest value recorded in the slot with the given index into
+ * counts. This is the inverse of countsIndex.
+ */
+uint64_t
+Histogram::valueFromIndex(size_t index) const {
+    int bucket = static_cast<int>(index >> subBucketHalfCountMagnitude) - 1;
+    uint64_t subBucket =
+        (index & (subBucketHalfCount - 1)) + subBucketHalfCount;
+    if (bucket < 0) {
+        subBucket -= subBucketHalfCount;
+        bucket = 0;
+    }
+    return subBucket << bucket;
+}
+
+/**
+ * Find the values of several order statistics in a single pass over the
+ * counts. The value reported for a rank is the highest value equivalent to
+ * the slot containing it, clamped to the exact minimum and maximum, so that
+ * quantiles are never under-reported. The first and last ranks report the
+ * exact minimum and maximum.
+ *
+ * \param ranks
+ *      Zero-based ranks to look up, in non-decreasing order. Each must be
+ *      less than the number of values recorded.
+ * \param values
+ *      The value for ranks[i] is stored in values[i].
+ * \param numRanks
+ *      Number of entries in ranks and values.
+ */
+void
+Histogram::valuesAtRanks(const uint64_t* ranks, uint64_t* values,
+                         size_t numRanks) const {
+    uint64_t cumulative = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < numCounts && next < numRanks; i++) {
+        cumulative += counts[i];
+        while (next < numRanks && ranks[next] < cumulative) {
+            uint64_t value = highestEquivalentValue(valueFromIndex(i));
+            if (ranks[next] == 0 || value < min)
+                value = min;
+            if (ranks[next] == totalCount - 1 || i == numCounts - 1 ||
+                value > max)
+                value = max;
+            values[next++] = value;
+        }
+    }
+}
+
+/**
+ * Return the value below which the given fraction of recorded values fall,
+ * using the same rank convention as ::computeStatistics.
+ *
+ * \param quantile
+ *      A fraction between 0 and 1; for example, 0.99 for the 99th
+ *      percentile.
+ */
+uint64_t
+Histogram::valueAtQuantile(double quantile) const {
+    if (totalCount == 0)
+        return 0;
+    uint64_t rank = static_cast<uint64_t>(
+        static_cast<double>(totalCount) * quantile);
+    if (rank >= totalCount)
+        rank = totalCount - 1;
+    uint64_t value;
+    valuesAtRanks(&rank, &value, 1);
+    return value;
+}
+
+/**
+ * Find the values at several quantiles in a single pass over the counts.
+ *
+ * \param quantiles
+ *      Fractions between 0 and 1, in any order.
+ * \param values
+ *      The value at quantiles[i] is stored in values[i].
+ * \param numQuantiles
+ *      Number of entries in quantiles and values.
+ */
+void
+Histogram::valuesAtQuantiles(const double* quantiles, uint64_t* values,
+                             size_t numQuantiles) const {
+    if (totalCount == 0) {
+        for (size_t i = 0; i < numQuantiles; i++)
+            values[i] = 0;
+        return;
+    }
+
+    // valuesAtRanks needs the ranks in order, so sort a permutation of them.
+    std::vector<uint64_t> ranks(numQuantiles);
+    std::vector<size_t> order(numQuantiles);
+    for (size_t i = 0; i < numQuantiles; i++) {
+        ranks[i] = static_cast<uint64_t>(static_cast<double>(totalCount) *
+                                         quantiles[i]);
+        if (ranks[i] >= totalCount)
+            ranks[i] = totalCount - 1;
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&ranks](size_t a, size_t b) {
+        return ranks[a] < ranks[b];
+    });
+    std::vector<uint64_t> sortedRanks(numQuantiles);
+    std::vector<uint64_t> sortedValues(numQuantiles);
+    for (size_t i = 0; i < numQuantiles; i++)
+        sortedRanks[i] = ranks[order[i]];
+    valuesAtRanks(sortedRanks.data(), sortedValues.data(), numQuantiles);
+    for (size_t i = 0; i < numQuantiles; i++)
+        values[order[i]] = sortedValues[i];
+}
+
+/**
+ * Return the contents of every non-empty slot, in increasing order of
+ * value. Each slot is represented by the value that valueAtQuantile reports
+ * for it: the highest value in the slot, clamped to the exact minimum and
+ * maximum.
+ *
+ * \param values
+ *      Filled in with the value of each non-empty slot.
+ * \param bucketCounts
+ *      Filled in with the number of values recorded in each of those slots.
+ */
+void
+Histogram::getBuckets(std::vector<uint64_t>* values,
+                      std::vector<uint64_t>* bucketCounts) const {
+    values->clear();
+    bucketCounts->clear();
+    for (size_t i = 0; i < numCounts; i++) {
+        if (counts[i] == 0)
+            continue;
+        uint64_t value = highestEquivalentValue(valueFromIndex(i));
+        value = value < min ? min : value;
+        value = value > max || i == numCounts - 1 ? max : value;
+        values->push_back(value);
+        bucketCounts->push_back(counts[i]);
+    }
+}
+
+/**
+ * Return the moments of the recorded values, treating every value as the
+ * midpoint of its slot.
+ */
+Moments
+Histogram::computeMoments() const {
+    Moments moments;
+    for (size_t i = 0; i < numCounts; i++) {
+        if (counts[i] == 0)
+            continue;
+        uint64_t lowest = valueFromIndex(i);
+        uint64_t mid = lowest + (highestEquivalentValue(lowest) - lowest) / 2;
+        moments.record(static_cast<double>(mid), counts[i]);
+    }
+    return moments;
+}
+
+/**
+ * Compute the same summary statistics as ::computeStatistics, directly from
+ * the recorded values. Percentiles are accurate to the precision of the
+ * histogram; the minimum and maximum are exact. The average and standard
+ * deviation are computed from the midpoint of each slot.
+ */
+Statistics
+Histogram::computeStatistics() const {
+    Statistics stats = Statistics();
+    if (totalCount == 0)
+        return stats;
+
+    static const double quantiles[] = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6,
+                                       0.7, 0.8, 0.9, 0.99, 0.999, 0.9999};
+    static const size_t numQuantiles = sizeof(quantiles) / sizeof(double);
+    uint64_t ranks[numQuantiles + 2];
+    uint64_t values[numQuantiles + 2];
+    ranks[0] = 0;
+    for (size_t i = 0; i < numQuantiles; i++) {
+        ranks[i + 1] = static_cast<uint64_t>(
+            static_cast<double>(totalCount) * quantiles[i]);
+    }
+    ranks[numQuantiles + 1] = totalCount - 1;
+    valuesAtRanks(ranks, values, numQuantiles + 2);
+
+    Moments moments = computeMoments();
+    stats.count = totalCount;
+    stats.average = static_cast<uint64_t>(moments.getMean());
+    stats.stddev = static_cast<uint64_t>(moments.getStddev());
+    stats.min = values[0];
+    stats.P10 = values[1];
+    stats.P20 = values[2];
+    stats.P30 = values[3];
+    stats.P40 = values[4];
+    stats.P50 = values[5];
+    stats.median = values[5];
+    stats.P60 = values[6];
+    stats.P70 = values[7];
+    stats.P80 = values[8];
+    stats.P90 = values[9];
+    stats.P99 = values[10];
+    stats.P999 = values[11];
+    stats.P9999 = values[12];
+    stats.max = values[13];
+    return stats;
+}
+
+/**
+ * Compute the fixed summary statistics together with the values at an
+ * arbitrary list of quantiles.
+ *
+ * \param quantiles
+ *      Fractions between 0 and 1 at which to report values.
+ */
+ExtendedStatistics
+Histogram::computeStatistics(const std::vector<double>& quantiles) const {
+    ExtendedStatistics stats;
+    stats.base = computeStatistics();
+    Moments moments = computeMoments();
+    stats.skewness = moments.getSkewness();
+    stats.kurtosis = moments.getKurtosis();
+    stats.quantiles = quantiles;
+    stats.values.resize(quantiles.size());
+    valuesAtQuantiles(quantiles.data(), stats.values.data(), quantiles.size());
+    return stats;
+}
+
+/**
+ * Return the mean of the recorded values left after discarding the lowest
+ * lowerFraction and the highest upperFraction of them, using the midpoint of
+ * each slot.
+ */
+double
+Histogram::trimmedMean(double lowerFraction, double upperFraction) const {
+    uint64_t low = static_cast<uint64_t>(static_cast<double>(totalCount) *
+                                         lowerFraction);
+    uint64_t high = totalCount - static_cast<uint64_t>(
+        static_cast<double>(totalCount) * upperFraction);
+    if (high <= low)
+        return 0;
+
+    // Walk the slots, counting only the part of each slot that falls in the
+    // ranks [low, high).
+    double sum = 0;
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < numCounts && cumulative < high; i++) {
+        uint64_t first = cumulative;
+        cumulative += counts[i];
+        if (counts[i] == 0 || cumulative <= low)
+            continue;
+        uint64_t kept = std::min(cumulative, high) - std::max(first, low);
+        uint64_t lowest = valueFromIndex(i);
+        uint64_t mid = lowest + (highestEquivalentValue(lowest) - lowest) / 2;
+        if (mid < min)
+            mid = min;
+        if (mid > max || i == numCounts - 1)
+            mid = max;
+        sum += static_cast<double>(kept) * static_cast<double>(mid);
+    }
+    return sum / static_cast<double>(high - low);
+}
+
+}  // namespace PerfUtils
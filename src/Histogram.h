@@ -0,0 +1,179 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PERFUTILS_HISTOGRAM_H
+#define PERFUTILS_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "Moments.h"
+#include "Stats.h"
+
+namespace PerfUtils {
+
+/**
+ * This class records a distribution of non-negative integer values (usually
+ * latencies in cycles) in a log-linear histogram, in the style of
+ * HdrHistogram. Values are grouped into power-of-two buckets, and each bucket
+ * is divided linearly into enough sub-buckets to preserve the requested
+ * number of significant decimal digits. Recording a value is O(1), and the
+ * memory used depends only on the precision and range, not on the number of
+ * values recorded, so it can be used in place of a raw sample array when
+ * the number of samples is very large.
+ *
+ * Values below 2 * 10^significantDigits are recorded exactly. Larger values
+ * are recorded with a relative error of at most 10^-significantDigits.
+ *
+ * This class is not thread-safe.
+ */
+class Histogram {
+  public:
+    explicit Histogram(int significantDigits = 3,
+                       uint64_t highestTrackableValue = UINT64_MAX);
+    Histogram(const Histogram& other);
+    Histogram& operator=(const Histogram& other);
+    ~Histogram();
+
+    /**
+     * Record a single occurrence of a value.
+     *
+     * \param value
+     *      The value to record. Values above the highest trackable value are
+     *      counted in the last bucket, but still update the exact maximum.
+     */
+    inline void record(uint64_t value) {
+        record(value, 1);
+    }
+
+    /**
+     * Record several occurrences of the same value.
+     *
+     * \param value
+     *      The value to record.
+     * \param count
+     *      The number of times value occurred.
+     */
+    inline void record(uint64_t value, uint64_t count) {
+        if (value > highestTrackableValue) {
+            counts[numCounts - 1] += count;
+        } else {
+            counts[countsIndex(value)] += count;
+        }
+        totalCount += count;
+        if (value < min)
+            min = value;
+        if (value > max)
+            max = value;
+    }
+
+    void recordWithExpectedInterval(uint64_t value,
+                                    uint64_t expectedInterval);
+    void add(const Histogram& other);
+    void reset();
+
+    uint64_t valueAtQuantile(double quantile) const;
+    void valuesAtQuantiles(const double* quantiles, uint64_t* values,
+                           size_t numQuantiles) const;
+    Statistics computeStatistics() const;
+    ExtendedStatistics computeStatistics(
+        const std::vector<double>& quantiles) const;
+    double trimmedMean(double lowerFraction, double upperFraction) const;
+    Moments computeMoments() const;
+    void getBuckets(std::vector<uint64_t>* values,
+                    std::vector<uint64_t>* bucketCounts) const;
+
+    /// Return the total number of values recorded.
+    uint64_t getCount() const { return totalCount; }
+
+    /// Return the smallest value recorded, or 0 if there are none.
+    uint64_t getMin() const { return totalCount == 0 ? 0 : min; }
+
+    /// Return the largest value recorded, or 0 if there are none.
+    uint64_t getMax() const { return max; }
+
+    /// Return the number of significant decimal digits preserved.
+    int getSignificantDigits() const { return significantDigits; }
+
+    /// Return the number of bytes used for bucket counts.
+    size_t getMemorySize() const { return numCounts * sizeof(uint64_t); }
+
+    uint64_t lowestEquivalentValue(uint64_t value) const;
+    uint64_t highestEquivalentValue(uint64_t value) const;
+
+  private:
+    // Records into the internals of Histogram directly, so that its
+    // per-thread histograms can be read while they are being written.
+    friend class LatencyRecorder;
+
+    /**
+     * Return the index of the power-of-two bucket that holds value.
+     */
+    inline int bucketIndex(uint64_t value) const {
+        return 64 - __builtin_clzll(value | subBucketMask) -
+               (subBucketHalfCountMagnitude + 1);
+    }
+
+    /**
+     * Return the index into counts of the slot that holds value.
+     */
+    inline size_t countsIndex(uint64_t value) const {
+        int bucket = bucketIndex(value);
+        uint64_t subBucket = value >> bucket;
+        return (static_cast<size_t>(bucket + 1)
+                << subBucketHalfCountMagnitude) +
+               (subBucket - subBucketHalfCount);
+    }
+
+    uint64_t valueFromIndex(size_t index) const;
+    void valuesAtRanks(const uint64_t* ranks, uint64_t* values,
+                       size_t numRanks) const;
+
+    // Number of significant decimal digits preserved by this histogram.
+    int significantDigits;
+
+    // Largest value that is tracked with full precision.
+    uint64_t highestTrackableValue;
+
+    // log2 of half the number of sub-buckets in each bucket.
+    int subBucketHalfCountMagnitude;
+
+    // Half the number of sub-buckets in each bucket. Every bucket except
+    // the first only uses its upper half, since its lower half overlaps the
+    // previous bucket.
+    uint64_t subBucketHalfCount;
+
+    // Mask covering all the sub-bucket indices of the first bucket.
+    uint64_t subBucketMask;
+
+    // Number of slots in counts.
+    size_t numCounts;
+
+    // Number of values recorded in each slot.
+    uint64_t* counts;
+
+    // Total number of values recorded.
+    uint64_t totalCount;
+
+    // Exact smallest and largest values recorded.
+    uint64_t min;
+    uint64_t max;
+};
+
+}  // namespace PerfUtils
+
+#endif  // PERFUTILS_HISTOGRAM_H
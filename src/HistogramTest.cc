@@ -0,0 +1,204 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Histogram.h"
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::Histogram;
+
+TEST(HistogramTest, exactForSmallValues) {
+    const int numElements = 1000;
+    uint64_t input[numElements];
+    Histogram histogram;
+    for (uint64_t i = 0; i < numElements; i++) {
+        input[i] = (i * 7919) % numElements;
+        histogram.record(input[i]);
+    }
+    Statistics expected = computeStatistics(input, numElements);
+    Statistics stats = histogram.computeStatistics();
+    EXPECT_EQ(expected.count, stats.count);
+    EXPECT_EQ(expected.average, stats.average);
+    EXPECT_EQ(expected.stddev, stats.stddev);
+    EXPECT_EQ(expected.min, stats.min);
+    EXPECT_EQ(expected.median, stats.median);
+    EXPECT_EQ(expected.P10, stats.P10);
+    EXPECT_EQ(expected.P50, stats.P50);
+    EXPECT_EQ(expected.P90, stats.P90);
+    EXPECT_EQ(expected.P99, stats.P99);
+    EXPECT_EQ(expected.P999, stats.P999);
+    EXPECT_EQ(expected.P9999, stats.P9999);
+    EXPECT_EQ(expected.max, stats.max);
+}
+
+TEST(HistogramTest, relativeErrorForLargeValues) {
+    const int numElements = 100000;
+    std::vector<uint64_t> input(numElements);
+    Histogram histogram(3);
+    srand(42);
+    for (int i = 0; i < numElements; i++) {
+        input[i] = (static_cast<uint64_t>(rand()) << 8) + rand() % 256;
+        histogram.record(input[i]);
+    }
+    Statistics expected = computeStatistics(input.data(), numElements);
+    Statistics stats = histogram.computeStatistics();
+    EXPECT_EQ(expected.min, stats.min);
+    EXPECT_EQ(expected.max, stats.max);
+    EXPECT_NEAR(expected.median, stats.median, expected.median / 1000.0);
+    EXPECT_NEAR(expected.P99, stats.P99, expected.P99 / 1000.0);
+    EXPECT_NEAR(expected.P999, stats.P999, expected.P999 / 1000.0);
+    EXPECT_NEAR(expected.average, stats.average, expected.average / 1000.0);
+    EXPECT_GE(stats.P99, expected.P99);
+}
+
+TEST(HistogramTest, valueAtQuantile) {
+    Histogram histogram;
+    EXPECT_EQ(0U, histogram.valueAtQuantile(0.5));
+    for (uint64_t i = 1; i <= 100; i++)
+        histogram.record(i);
+    EXPECT_EQ(1U, histogram.valueAtQuantile(0));
+    EXPECT_EQ(51U, histogram.valueAtQuantile(0.5));
+    EXPECT_EQ(100U, histogram.valueAtQuantile(0.999));
+    EXPECT_EQ(100U, histogram.valueAtQuantile(1.0));
+}
+
+TEST(HistogramTest, addAndReset) {
+    Histogram a(2, 1000000);
+    Histogram b(2, 1000000);
+    Histogram c(4);
+    a.record(10, 5);
+    b.record(20, 5);
+    c.record(123456);
+    a.add(b);
+    EXPECT_EQ(10U, a.getCount());
+    EXPECT_EQ(10U, a.getMin());
+    EXPECT_EQ(20U, a.getMax());
+    EXPECT_EQ(20U, a.valueAtQuantile(0.5));
+
+    a.add(c);
+    EXPECT_EQ(11U, a.getCount());
+    EXPECT_EQ(123456U, a.getMax());
+
+    Histogram copy(a);
+    a.reset();
+    EXPECT_EQ(0U, a.getCount());
+    EXPECT_EQ(0U, a.getMin());
+    EXPECT_EQ(0U, a.computeStatistics().count);
+    EXPECT_EQ(11U, copy.getCount());
+
+    a = copy;
+    EXPECT_EQ(11U, a.getCount());
+    EXPECT_EQ(123456U, a.getMax());
+}
+
+TEST(HistogramTest, addMismatchedPrecision) {
+    // The values are re-recorded at the lower precision, but the minimum and
+    // maximum stay the values actually recorded.
+    Histogram coarse(2);
+    Histogram fine(4);
+    fine.record(123456);
+    fine.record(123789);
+    coarse.add(fine);
+    EXPECT_EQ(2U, coarse.getCount());
+    EXPECT_EQ(123456U, coarse.getMin());
+    EXPECT_EQ(123789U, coarse.getMax());
+    EXPECT_EQ(123456U, coarse.computeStatistics().min);
+    EXPECT_EQ(123789U, coarse.computeStatistics().max);
+
+    // A smaller minimum already in this histogram is kept.
+    Histogram other(2);
+    other.record(100);
+    other.add(fine);
+    EXPECT_EQ(100U, other.getMin());
+}
+
+TEST(HistogramTest, equivalentValues) {
+    Histogram histogram(2);
+    EXPECT_EQ(100U, histogram.lowestEquivalentValue(100));
+    EXPECT_EQ(100U, histogram.highestEquivalentValue(100));
+    EXPECT_EQ(1000U, histogram.lowestEquivalentValue(1001));
+    EXPECT_EQ(1003U, histogram.highestEquivalentValue(1001));
+}
+
+TEST(HistogramTest, boundedMemory) {
+    Histogram histogram(3, 1UL << 40);
+    size_t memory = histogram.getMemorySize();
+    for (uint64_t i = 0; i < 1000000; i++)
+        histogram.record(i * 1000003);
+    EXPECT_EQ(memory, histogram.getMemorySize());
+    EXPECT_GT(1UL << 20, memory);
+    EXPECT_EQ(1000000U, histogram.getCount());
+    EXPECT_EQ(999999UL * 1000003, histogram.getMax());
+}
+
+TEST(HistogramTest, arbitraryQuantiles) {
+    Histogram histogram;
+    for (uint64_t i = 0; i < 1000; i++)
+        histogram.record(i);
+    double quantiles[] = {0.999, 0.5, 0.1};
+    uint64_t values[3];
+    histogram.valuesAtQuantiles(quantiles, values, 3);
+    EXPECT_EQ(999U, values[0]);
+    EXPECT_EQ(500U, values[1]);
+    EXPECT_EQ(100U, values[2]);
+
+    ExtendedStatistics stats = histogram.computeStatistics({0.95, 0.05});
+    EXPECT_EQ(1000U, stats.base.count);
+    ASSERT_EQ(2U, stats.values.size());
+    EXPECT_EQ(950U, stats.values[0]);
+    EXPECT_EQ(50U, stats.values[1]);
+}
+
+TEST(HistogramTest, trimmedMean) {
+    Histogram histogram;
+    for (uint64_t i = 0; i < 100; i++)
+        histogram.record(i);
+    histogram.record(1000000);
+    EXPECT_DOUBLE_EQ(50, histogram.trimmedMean(0.1, 0.1));
+
+    // With 101 values, trimming half from each end keeps only the median.
+    EXPECT_DOUBLE_EQ(50, histogram.trimmedMean(0.5, 0.5));
+    EXPECT_DOUBLE_EQ(0, histogram.trimmedMean(0.6, 0.6));
+}
+
+TEST(HistogramTest, recordWithExpectedInterval) {
+    Histogram raw, corrected;
+    for (int i = 0; i < 10000; i++) {
+        raw.record(1000);
+        corrected.recordWithExpectedInterval(1000, 10000);
+    }
+    // One 100ms stall while requests were due every 10us.
+    raw.record(100000000);
+    corrected.recordWithExpectedInterval(100000000, 10000);
+
+    EXPECT_EQ(10001U, raw.getCount());
+    EXPECT_EQ(20000U, corrected.getCount());
+    EXPECT_EQ(1000U, raw.valueAtQuantile(0.99));
+    EXPECT_EQ(1000U, corrected.valueAtQuantile(0.49));
+    EXPECT_NEAR(98000000.0, corrected.valueAtQuantile(0.99),
+                98000000.0 / 1000);
+    EXPECT_EQ(100000000U, corrected.getMax());
+
+    // No correction without an interval, or for fast samples.
+    Histogram histogram;
+    histogram.recordWithExpectedInterval(500, 0);
+    histogram.recordWithExpectedInterval(500, 1000);
+    EXPECT_EQ(2U, histogram.getCount());
+}
@@ -0,0 +1,168 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "LatencyRecorder.h"
+
+#include <string.h>
+
+#include <new>
+
+#include "Util.h"
+
+#define CACHE_LINE_SIZE 64
+
+namespace PerfUtils {
+
+__thread LatencyRecorder::ThreadCacheEntry
+    LatencyRecorder::threadCache[THREAD_CACHE_SIZE];
+std::atomic<uint64_t> LatencyRecorder::nextId(1);
+
+/**
+ * Construct a LatencyRecorder with no values recorded.
+ *
+ * \param significantDigits
+ *      Number of significant decimal digits preserved by each thread's
+ *      histogram; see Histogram::Histogram.
+ * \param highestTrackableValue
+ *      Largest value that needs to be recorded with full precision; see
+ *      Histogram::Histogram.
+ */
+LatencyRecorder::LatencyRecorder(int significantDigits,
+                                 uint64_t highestTrackableValue)
+    : id(nextId++),
+      prototype(significantDigits, highestTrackableValue),
+      shards(),
+      mutex() {}
+
+/**
+ * Destroy the recorder and every thread's histogram. No thread may be
+ * recording into the recorder when it is destroyed.
+ */
+LatencyRecorder::~LatencyRecorder() {
+    for (size_t i = 0; i < shards.size(); i++)
+        Shard::destroy(shards[i].second);
+}
+
+/**
+ * Slow path for record: find or create the calling thread's shard and store
+ * it in the thread's cache.
+ */
+void
+LatencyRecorder::fillThreadCache(ThreadCacheEntry* entry) {
+    pid_t tid = Util::gettid();
+    std::lock_guard<std::mutex> guard(mutex);
+    Shard* shard = NULL;
+    for (size_t i = 0; i < shards.size(); i++) {
+        if (shards[i].first == tid) {
+            shard = shards[i].second;
+            break;
+        }
+    }
+    if (shard == NULL) {
+        shard = Shard::create(prototype);
+        shards.push_back(std::make_pair(tid, shard));
+    }
+    entry->shard = shard;
+    entry->id = id;
+}
+
+/**
+ * Return a histogram holding every value recorded so far, by any thread.
+ */
+Histogram
+LatencyRecorder::snapshot() const {
+    Histogram result(prototype);
+    std::lock_guard<std::mutex> guard(mutex);
+    for (size_t i = 0; i < shards.size(); i++)
+        shards[i].second->addTo(&result);
+    return result;
+}
+
+/**
+ * Compute summary statistics over every value recorded so far, by any
+ * thread. This is shorthand for snapshot().computeStatistics().
+ */
+Statistics
+LatencyRecorder::computeStatistics() const {
+    return snapshot().computeStatistics();
+}
+
+size_t
+LatencyRecorder::getNumThreads() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return shards.size();
+}
+
+/**
+ * Construct an empty shard with the same precision and range as prototype,
+ * whose counts are on cache lines of their own.
+ */
+LatencyRecorder::Shard::Shard(const Histogram& prototype)
+    : histogram(prototype) {
+    size_t size = (histogram.getMemorySize() + CACHE_LINE_SIZE - 1) &
+                  ~(CACHE_LINE_SIZE - 1);
+    free(histogram.counts);
+    histogram.counts =
+        reinterpret_cast<uint64_t*>(Util::cacheAlignAlloc(size));
+    memset(histogram.counts, 0, size);
+}
+
+/**
+ * Allocate a new shard at the start of a cache line, padded to a whole
+ * number of cache lines.
+ */
+LatencyRecorder::Shard*
+LatencyRecorder::Shard::create(const Histogram& prototype) {
+    size_t size = (sizeof(Shard) + CACHE_LINE_SIZE - 1) &
+                  ~(CACHE_LINE_SIZE - 1);
+    return new (Util::cacheAlignAlloc(size)) Shard(prototype);
+}
+
+/**
+ * Free a shard allocated by create.
+ */
+void
+LatencyRecorder::Shard::destroy(Shard* shard) {
+    shard->~Shard();
+    free(shard);
+}
+
+/**
+ * Add the values recorded in this shard so far to result, which must have
+ * the same precision and range. This may run concurrently with record.
+ */
+void
+LatencyRecorder::Shard::addTo(Histogram* result) const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < histogram.numCounts; i++) {
+        uint64_t count = load(&histogram.counts[i]);
+        result->counts[i] += count;
+        total += count;
+    }
+    if (total == 0)
+        return;
+
+    // Use the sum of the counts that were actually read, rather than the
+    // shard's total, so that the result is self-consistent.
+    result->totalCount += total;
+    uint64_t min = load(&histogram.min);
+    uint64_t max = load(&histogram.max);
+    if (min < result->min)
+        result->min = min;
+    if (max > result->max)
+        result->max = max;
+}
+
+}  // namespace PerfUtils
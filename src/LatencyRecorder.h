@@ -0,0 +1,162 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PERFUTILS_LATENCYRECORDER_H
+#define PERFUTILS_LATENCYRECORDER_H
+
+#include <stdint.h>
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Histogram.h"
+
+namespace PerfUtils {
+
+/**
+ * This class records a distribution of values (usually latencies) from many
+ * threads at once. Each thread records into its own Histogram, which sits on
+ * cache lines that no other thread writes, and updates it with plain loads
+ * and stores; there are no locked instructions or shared cache lines on the
+ * recording path. At any time, a reader can take a snapshot that merges the
+ * histograms of all threads, without stopping or slowing the writers.
+ *
+ * A snapshot taken while values are being recorded reflects some, but not
+ * necessarily all, of the values recorded concurrently with it. Each value is
+ * either fully included or not included at all, except that the snapshot's
+ * minimum and maximum may briefly lag its counts.
+ *
+ * This class is thread-safe.
+ */
+class LatencyRecorder {
+  public:
+    explicit LatencyRecorder(int significantDigits = 3,
+                             uint64_t highestTrackableValue = UINT64_MAX);
+    ~LatencyRecorder();
+
+    /**
+     * Record a value in the calling thread's histogram, creating that
+     * histogram if this is the thread's first record.
+     *
+     * \param value
+     *      The value to record.
+     */
+    inline void record(uint64_t value) {
+        ThreadCacheEntry* entry = &threadCache[id % THREAD_CACHE_SIZE];
+        if (entry->id != id)
+            fillThreadCache(entry);
+        entry->shard->record(value);
+    }
+
+    Histogram snapshot() const;
+    Statistics computeStatistics() const;
+
+    /// Return the number of threads that have recorded values so far.
+    size_t getNumThreads() const;
+
+  private:
+    /**
+     * One thread's histogram. Shards and their counts are allocated on
+     * cache lines of their own, and no two threads write to the same shard.
+     */
+    class Shard {
+      public:
+        static Shard* create(const Histogram& prototype);
+        static void destroy(Shard* shard);
+
+        /**
+         * Record a value. Only the owning thread may call this, but other
+         * threads may concurrently copy the shard with addTo.
+         */
+        inline void record(uint64_t value) {
+            size_t index =
+                value > histogram.highestTrackableValue
+                    ? histogram.numCounts - 1
+                    : histogram.countsIndex(value);
+            increment(&histogram.counts[index]);
+            increment(&histogram.totalCount);
+            if (value < load(&histogram.min))
+                store(&histogram.min, value);
+            if (value > load(&histogram.max))
+                store(&histogram.max, value);
+        }
+
+        void addTo(Histogram* result) const;
+
+      private:
+        explicit Shard(const Histogram& prototype);
+
+        /// Read a word that another thread may be writing.
+        static inline uint64_t load(const uint64_t* p) {
+            return __atomic_load_n(p, __ATOMIC_RELAXED);
+        }
+
+        /// Write a word that another thread may be reading.
+        static inline void store(uint64_t* p, uint64_t value) {
+            __atomic_store_n(p, value, __ATOMIC_RELAXED);
+        }
+
+        /// Increment a word that only this thread writes; this compiles to a
+        /// plain load, add and store.
+        static inline void increment(uint64_t* p) {
+            store(p, load(p) + 1);
+        }
+
+        // Holds the values recorded by the owning thread.
+        Histogram histogram;
+    };
+
+    /**
+     * Maps a recorder to the calling thread's shard for it.
+     */
+    struct ThreadCacheEntry {
+        uint64_t id;
+        Shard* shard;
+    };
+
+    void fillThreadCache(ThreadCacheEntry* entry);
+
+    // Number of recorders whose shard lookup each thread caches.
+    static const int THREAD_CACHE_SIZE = 8;
+
+    // Per-thread cache of shard lookups, indexed by recorder id.
+    static __thread ThreadCacheEntry threadCache[THREAD_CACHE_SIZE];
+
+    // Source of unique ids for recorders; ids are never reused, so a stale
+    // cache entry can never match a new recorder.
+    static std::atomic<uint64_t> nextId;
+
+    // Unique identifier for this recorder; never 0.
+    const uint64_t id;
+
+    // Histogram with the precision and range used by every shard; each new
+    // shard starts as an empty copy of it.
+    const Histogram prototype;
+
+    // Every shard created so far, together with the id of the thread that
+    // owns it. Entries are never removed before the recorder is destroyed.
+    std::vector<std::pair<pid_t, Shard*>> shards;
+
+    // Provides mutual exclusion on shards.
+    mutable std::mutex mutex;
+};
+
+}  // namespace PerfUtils
+
+#endif  // PERFUTILS_LATENCYRECORDER_H
@@ -0,0 +1,94 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "LatencyRecorder.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::Histogram;
+using PerfUtils::LatencyRecorder;
+
+TEST(LatencyRecorderTest, singleThread) {
+    LatencyRecorder recorder;
+    EXPECT_EQ(0U, recorder.computeStatistics().count);
+    for (uint64_t i = 0; i < 100; i++)
+        recorder.record(i);
+    Statistics stats = recorder.computeStatistics();
+    EXPECT_EQ(100U, stats.count);
+    EXPECT_EQ(0U, stats.min);
+    EXPECT_EQ(50U, stats.median);
+    EXPECT_EQ(99U, stats.max);
+    EXPECT_EQ(1U, recorder.getNumThreads());
+}
+
+TEST(LatencyRecorderTest, mergesThreads) {
+    const int numThreads = 8;
+    const uint64_t perThread = 100000;
+    LatencyRecorder recorder;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&recorder, t, perThread] {
+            for (uint64_t i = 0; i < perThread; i++)
+                recorder.record(t * 1000 + i % 1000);
+        });
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    Histogram merged = recorder.snapshot();
+    EXPECT_EQ(numThreads * perThread, merged.getCount());
+    EXPECT_EQ(0U, merged.getMin());
+    EXPECT_EQ((numThreads - 1) * 1000U + 999, merged.getMax());
+    EXPECT_EQ(static_cast<size_t>(numThreads), recorder.getNumThreads());
+}
+
+TEST(LatencyRecorderTest, independentRecorders) {
+    LatencyRecorder a;
+    LatencyRecorder b;
+    for (int i = 0; i < 10; i++) {
+        a.record(1);
+        b.record(2);
+        b.record(2);
+    }
+    EXPECT_EQ(10U, a.snapshot().getCount());
+    EXPECT_EQ(20U, b.snapshot().getCount());
+    EXPECT_EQ(2U, b.snapshot().getMin());
+}
+
+TEST(LatencyRecorderTest, snapshotWhileRecording) {
+    LatencyRecorder recorder;
+    std::atomic<bool> stop(false);
+    std::thread writer([&recorder, &stop] {
+        uint64_t i = 0;
+        while (!stop.load())
+            recorder.record(i++ % 5000);
+    });
+
+    // Counts seen by successive snapshots never go backwards.
+    uint64_t previous = 0;
+    for (int i = 0; i < 100; i++) {
+        uint64_t count = recorder.snapshot().getCount();
+        EXPECT_LE(previous, count);
+        previous = count;
+    }
+    stop = true;
+    writer.join();
+    EXPECT_LE(previous, recorder.snapshot().getCount());
+}
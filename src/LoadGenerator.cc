@@ -0,0 +1,191 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "LoadGenerator.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <random>
+
+namespace PerfUtils {
+
+/**
+ * Compute the start times of the operations offered at a given rate.
+ *
+ * \param process
+ *      Whether the gaps between operations are exponentially distributed
+ *      or equal.
+ * \param rate
+ *      Mean operations per second.
+ * \param seconds
+ *      Length of the schedule.
+ * \param seed
+ *      Seed for the exponential gaps.
+ * \return
+ *      The start time of each operation, in cycles from the start of the
+ *      schedule, in increasing order. This takes 8 bytes per operation.
+ */
+std::vector<uint64_t>
+arrivalSchedule(ArrivalProcess process, double rate, double seconds,
+                uint64_t seed) {
+    std::vector<uint64_t> schedule;
+    if (rate <= 0)
+        return schedule;
+    double cyclesPerOperation = Cycles::perSecond() / rate;
+    double end = static_cast<double>(Cycles::fromSeconds(seconds));
+    if (process == FIXED_RATE_ARRIVALS) {
+        uint64_t count = static_cast<uint64_t>(seconds * rate + 0.5);
+        for (uint64_t i = 0; i < count; i++)
+            schedule.push_back(
+                static_cast<uint64_t>(cyclesPerOperation * i));
+        return schedule;
+    }
+
+    std::mt19937_64 generator(seed);
+    std::exponential_distribution<double> gap(1.0);
+    for (double time = gap(generator) * cyclesPerOperation; time < end;
+         time += gap(generator) * cyclesPerOperation)
+        schedule.push_back(static_cast<uint64_t>(time));
+    return schedule;
+}
+
+/**
+ * Combine the latencies recorded by the threads of runOpenLoop into its
+ * result.
+ *
+ * \param offeredRate
+ *      The rate that was offered, over all threads.
+ * \param elapsedCycles
+ *      Time from the common start to the last completion.
+ * \param latencies
+ *      The latencies recorded by each thread.
+ */
+LoadPoint
+summarizeLoad(double offeredRate, uint64_t elapsedCycles,
+              const std::vector<Histogram>& latencies) {
+    Histogram merged;
+    for (size_t t = 0; t < latencies.size(); t++)
+        merged.add(latencies[t]);
+
+    LoadPoint point;
+    point.offeredRate = offeredRate;
+    point.operations = merged.getCount();
+    double seconds = Cycles::toSeconds(elapsedCycles);
+    point.achievedRate =
+        seconds > 0 ? static_cast<double>(point.operations) / seconds : 0;
+    point.latency = merged.computeStatistics();
+    return point;
+}
+
+/**
+ * Print the results of sweepLoad in CSV format, one row per rate, with
+ * latencies in cycles.
+ */
+void
+printLoadCurve(const std::vector<LoadPoint>& points, FILE* out) {
+    fprintf(out, "OfferedRate,AchievedRate,Operations,Median,99%%,99.9%%,"
+                 "Max\n");
+    for (size_t i = 0; i < points.size(); i++) {
+        const Statistics& latency = points[i].latency;
+        fprintf(out, "%.0f,%.0f,%lu,%lu,%lu,%lu,%lu\n",
+                points[i].offeredRate, points[i].achievedRate,
+                points[i].operations, latency.median, latency.P99,
+                latency.P999, latency.max);
+    }
+}
+
+/**
+ * Read or write exactly size bytes, retrying after partial transfers.
+ *
+ * \return
+ *      False if the connection was closed or failed first.
+ */
+template <typename Transfer>
+static bool
+transferAll(Transfer transfer, int fd, char* buffer, size_t size) {
+    while (size > 0) {
+        ssize_t count = transfer(fd, buffer, size);
+        if (count <= 0)
+            return false;
+        buffer += count;
+        size -= count;
+    }
+    return true;
+}
+
+/**
+ * Create the socket pairs and start an echo thread for each generator
+ * thread.
+ *
+ * \param numThreads
+ *      Number of generator threads that will use the target.
+ * \param messageSize
+ *      Bytes sent, and echoed back, by each operation; at most
+ *      MAX_MESSAGE_SIZE.
+ */
+EchoSocketTarget::EchoSocketTarget(int numThreads, size_t messageSize)
+    : messageSize(messageSize),
+      clientSockets(),
+      serverSockets(),
+      echoThreads() {
+    if (messageSize == 0 || messageSize > MAX_MESSAGE_SIZE)
+        PERFUTILS_DIE("EchoSocketTarget messages must be 1 to %lu bytes",
+                      MAX_MESSAGE_SIZE);
+    for (int t = 0; t < numThreads; t++) {
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+            PERFUTILS_DIE("EchoSocketTarget could not create sockets");
+        clientSockets.push_back(sockets[0]);
+        serverSockets.push_back(sockets[1]);
+    }
+    for (int t = 0; t < numThreads; t++) {
+        int fd = serverSockets[t];
+        echoThreads.emplace_back([fd, messageSize] {
+            std::vector<char> buffer(messageSize);
+            while (transferAll(::read, fd, buffer.data(), messageSize) &&
+                   transferAll(::write, fd, buffer.data(), messageSize)) {
+            }
+        });
+    }
+}
+
+/**
+ * Close the client sockets, which makes the echo threads exit, and wait
+ * for them.
+ */
+EchoSocketTarget::~EchoSocketTarget() {
+    for (size_t t = 0; t < clientSockets.size(); t++)
+        close(clientSockets[t]);
+    for (size_t t = 0; t < echoThreads.size(); t++)
+        echoThreads[t].join();
+    for (size_t t = 0; t < serverSockets.size(); t++)
+        close(serverSockets[t]);
+}
+
+/**
+ * Send one message on the given thread's socket and wait for the echo.
+ */
+void
+EchoSocketTarget::operator()(int thread) {
+    char message[MAX_MESSAGE_SIZE] = {};
+    int fd = clientSockets[thread];
+    if (!transferAll(::write, fd, message, messageSize) ||
+        !transferAll(::read, fd, message, messageSize))
+        PERFUTILS_DIE("EchoSocketTarget lost its connection");
+}
+
+}  // namespace PerfUtils
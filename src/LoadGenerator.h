@@ -0,0 +1,204 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PERFUTILS_LOADGENERATOR_H
+#define PERFUTILS_LOADGENERATOR_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <thread>
+#include <vector>
+
+#include "Cycles.h"
+#include "Histogram.h"
+#include "Perf.h"
+#include "Stats.h"
+#include "Util.h"
+
+namespace PerfUtils {
+
+/**
+ * How the start times of the operations issued by runOpenLoop are spaced.
+ */
+enum ArrivalProcess {
+    // Exponentially distributed gaps, as from many independent clients.
+    POISSON_ARRIVALS,
+
+    // Equal gaps.
+    FIXED_RATE_ARRIVALS
+};
+
+/**
+ * Parameters for runOpenLoop and sweepLoad.
+ */
+struct LoadOptions {
+    LoadOptions()
+        : process(POISSON_ARRIVALS),
+          duration(1.0),
+          cores({-1}),
+          seed(1) {}
+
+    ArrivalProcess process;
+
+    // Seconds of load offered at each rate.
+    double duration;
+
+    // One generator thread is started per entry, pinned to that core; a
+    // negative entry leaves the thread unpinned. The offered rate is split
+    // evenly between the threads.
+    std::vector<int> cores;
+
+    // Seed for the Poisson schedules, so that runs are reproducible.
+    uint64_t seed;
+};
+
+/**
+ * The result of offering one rate of load.
+ */
+struct LoadPoint {
+    // Operations per second that were scheduled, over all threads.
+    double offeredRate;
+
+    // Operations per second that were completed, from the common start to
+    // the last completion. This falls below offeredRate once the target
+    // saturates.
+    double achievedRate;
+
+    // Number of operations issued.
+    uint64_t operations;
+
+    // Statistics on the time from each operation's scheduled start to its
+    // completion, in cycles; a late start counts against the operation, so
+    // queueing behind slow operations shows up here. These come from a
+    // histogram with 3 significant digits.
+    Statistics latency;
+};
+
+std::vector<uint64_t> arrivalSchedule(ArrivalProcess process, double rate,
+                                      double seconds, uint64_t seed);
+LoadPoint summarizeLoad(double offeredRate, uint64_t elapsedCycles,
+                        const std::vector<Histogram>& latencies);
+void printLoadCurve(const std::vector<LoadPoint>& points, FILE* out);
+
+/**
+ * Offer load to a target at a fixed rate, regardless of how fast it
+ * responds (an open loop), and measure its latency under that load.
+ *
+ * Each thread computes its whole schedule of start times in advance, then
+ * the threads start on a common cycle counter tick. Each thread spins until
+ * the deadline of its next operation, or starts at once if it is already
+ * late, and records the time from the deadline to the operation's
+ * completion.
+ *
+ * \param operation
+ *      A callable taking the index of the calling thread, from 0 to
+ *      options.cores.size() - 1, that performs one operation and returns
+ *      when it completes.
+ * \param rate
+ *      Operations per second to offer, over all threads.
+ * \param options
+ *      The arrival process, duration and threads.
+ */
+template <typename Function>
+LoadPoint
+runOpenLoop(Function&& operation, double rate, const LoadOptions& options) {
+    size_t numThreads = options.cores.size();
+    std::vector<Histogram> latencies(numThreads);
+    std::vector<uint64_t> endTimes(numThreads);
+    std::vector<std::vector<uint64_t>> schedules(numThreads);
+    uint64_t start = runOnCores(options.cores,
+        [&](int thread) {
+            schedules[thread] = arrivalSchedule(
+                options.process, rate / static_cast<double>(numThreads),
+                options.duration, options.seed + thread);
+        },
+        [&](int thread, uint64_t start) {
+            // Record into a local histogram, so that the threads do not
+            // share cache lines while the load is running.
+            const std::vector<uint64_t>& schedule = schedules[thread];
+            Histogram local;
+            uint64_t now = start;
+            for (size_t i = 0; i < schedule.size(); i++) {
+                uint64_t deadline = start + schedule[i];
+                while (Cycles::rdtsc() < deadline)
+                    _mm_pause();
+                operation(thread);
+                now = Cycles::rdtsc();
+                local.record(now - deadline);
+            }
+            latencies[thread] = local;
+            endTimes[thread] = now;
+        });
+
+    uint64_t end = start;
+    for (size_t t = 0; t < numThreads; t++)
+        end = endTimes[t] > end ? endTimes[t] : end;
+    return summarizeLoad(rate, end - start, latencies);
+}
+
+/**
+ * Run runOpenLoop at each of a list of rates, to show how latency grows
+ * as the offered load approaches the target's capacity; printLoadCurve
+ * prints the result.
+ */
+template <typename Function>
+std::vector<LoadPoint>
+sweepLoad(Function&& operation, const std::vector<double>& rates,
+          const LoadOptions& options) {
+    std::vector<LoadPoint> points;
+    for (size_t i = 0; i < rates.size(); i++)
+        points.push_back(runOpenLoop(operation, rates[i], options));
+    return points;
+}
+
+/**
+ * A stand-in for a network service, for driving runOpenLoop through the
+ * kernel's socket path instead of a function call. Each generator thread
+ * gets its own connected pair of local sockets, with an echo thread on
+ * the far end; an operation sends one small message and waits for the
+ * reply.
+ *
+ * Use it as the operation: runOpenLoop(std::ref(target), rate, options).
+ */
+class EchoSocketTarget {
+  public:
+    explicit EchoSocketTarget(int numThreads, size_t messageSize = 64);
+    ~EchoSocketTarget();
+
+    void operator()(int thread);
+
+    // Largest message size supported.
+    static const size_t MAX_MESSAGE_SIZE = 4096;
+
+  private:
+    // Size of each message.
+    size_t messageSize;
+
+    // The socket used by each generator thread.
+    std::vector<int> clientSockets;
+
+    // The socket served by each echo thread.
+    std::vector<int> serverSockets;
+
+    std::vector<std::thread> echoThreads;
+
+    EchoSocketTarget(const EchoSocketTarget&) = delete;
+    EchoSocketTarget& operator=(const EchoSocketTarget&) = delete;
+};
+
+}  // namespace PerfUtils
+
+#endif  // PERFUTILS_LOADGENERATOR_H
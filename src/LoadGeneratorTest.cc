@@ -0,0 +1,108 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "LoadGenerator.h"
+
+#include <stdio.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::Cycles;
+using PerfUtils::LoadOptions;
+using PerfUtils::LoadPoint;
+
+TEST(LoadGeneratorTest, fixedRateSchedule) {
+    std::vector<uint64_t> schedule = PerfUtils::arrivalSchedule(
+        PerfUtils::FIXED_RATE_ARRIVALS, 1000, 0.01, 1);
+    ASSERT_EQ(10U, schedule.size());
+    EXPECT_EQ(0U, schedule[0]);
+    uint64_t gap = Cycles::fromSeconds(0.001);
+    EXPECT_NEAR(static_cast<double>(gap),
+                static_cast<double>(schedule[5] - schedule[4]), 2);
+    EXPECT_TRUE(PerfUtils::arrivalSchedule(PerfUtils::FIXED_RATE_ARRIVALS,
+                                           0, 1, 1).empty());
+}
+
+TEST(LoadGeneratorTest, poissonSchedule) {
+    std::vector<uint64_t> schedule = PerfUtils::arrivalSchedule(
+        PerfUtils::POISSON_ARRIVALS, 100000, 1, 7);
+    EXPECT_NEAR(100000, static_cast<double>(schedule.size()), 2000);
+    for (size_t i = 1; i < schedule.size(); i++)
+        ASSERT_LE(schedule[i - 1], schedule[i]);
+    EXPECT_LT(schedule.back(), Cycles::fromSeconds(1));
+    EXPECT_EQ(schedule, PerfUtils::arrivalSchedule(
+                            PerfUtils::POISSON_ARRIVALS, 100000, 1, 7));
+}
+
+TEST(LoadGeneratorTest, runOpenLoop) {
+    std::atomic<uint64_t> calls(0);
+    LoadOptions options;
+    options.process = PerfUtils::FIXED_RATE_ARRIVALS;
+    options.duration = 0.05;
+    options.cores = {-1, -1};
+    LoadPoint point = PerfUtils::runOpenLoop(
+        [&calls](int) { calls++; }, 2000, options);
+    EXPECT_EQ(100U, point.operations);
+    EXPECT_EQ(100U, calls.load());
+    EXPECT_EQ(2000, point.offeredRate);
+    EXPECT_LT(0, point.achievedRate);
+    EXPECT_EQ(100U, point.latency.count);
+}
+
+TEST(LoadGeneratorTest, latencyIncludesQueueing) {
+    // Each operation takes 2 ms but one is scheduled every 1 ms, so the
+    // n-th one starts about n ms late.
+    LoadOptions options;
+    options.process = PerfUtils::FIXED_RATE_ARRIVALS;
+    options.duration = 0.02;
+    LoadPoint point = PerfUtils::runOpenLoop(
+        [](int) {
+            uint64_t end = Cycles::rdtsc() + Cycles::fromSeconds(0.002);
+            while (Cycles::rdtsc() < end) {
+            }
+        },
+        1000, options);
+    EXPECT_EQ(20U, point.operations);
+    EXPECT_LT(Cycles::fromSeconds(0.015), point.latency.max);
+    EXPECT_GT(800, point.achievedRate);
+}
+
+TEST(LoadGeneratorTest, sweepAndPrint) {
+    PerfUtils::EchoSocketTarget target(1);
+    LoadOptions options;
+    options.duration = 0.02;
+    std::vector<LoadPoint> points = PerfUtils::sweepLoad(
+        std::ref(target), std::vector<double>{500, 1000}, options);
+    ASSERT_EQ(2U, points.size());
+    EXPECT_EQ(500, points[0].offeredRate);
+    EXPECT_EQ(1000, points[1].offeredRate);
+    EXPECT_LT(0U, points[1].operations);
+
+    FILE* out = tmpfile();
+    PerfUtils::printLoadCurve(points, out);
+    std::string text(ftell(out), '\0');
+    rewind(out);
+    EXPECT_EQ(text.size(), fread(&text[0], 1, text.size(), out));
+    fclose(out);
+    EXPECT_EQ(0U, text.find("OfferedRate,AchievedRate,Operations,Median,"
+                            "99%,99.9%,Max\n500,"));
+    EXPECT_NE(std::string::npos, text.find("\n1000,"));
+}
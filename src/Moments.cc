@@ -0,0 +1,236 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Moments.h"
+
+#include <math.h>
+
+namespace PerfUtils {
+
+const size_t Moments::CHUNK_SIZE;
+
+Moments::Moments() : count(0), mean(0), m2(0), m3(0), m4(0) {}
+
+/**
+ * Record several occurrences of the same value; this is how a histogram
+ * bucket is folded in.
+ *
+ * \param value
+ *      The value to record.
+ * \param count
+ *      The number of times value occurred.
+ */
+void
+Moments::record(double value, uint64_t count) {
+    if (count == 0)
+        return;
+    Moments group;
+    group.count = count;
+    group.mean = value;
+    add(group);
+}
+
+/**
+ * Record an array of integer samples. The array is processed in chunks of
+ * CHUNK_SIZE samples, each summarized by ofSamples relative to the first
+ * sample, and the chunks are merged in order. Code that summarizes the
+ * chunks in parallel and merges them in the same order gets exactly the
+ * same result.
+ *
+ * \param values
+ *      The samples to record.
+ * \param count
+ *      Number of samples in values.
+ * \param sum
+ *      If not NULL, the exact sum of the samples is added to this.
+ */
+void
+Moments::record(const uint64_t* values, size_t count,
+                unsigned __int128* sum) {
+    if (count == 0)
+        return;
+    Moments total;
+    for (size_t start = 0; start < count; start += CHUNK_SIZE) {
+        size_t length =
+            count - start < CHUNK_SIZE ? count - start : CHUNK_SIZE;
+        total.add(ofSamples(values + start, length, values[0], sum));
+    }
+    total.offset(static_cast<double>(values[0]));
+    add(total);
+}
+
+/**
+ * Return the moments of values[i] - origin. Working relative to an origin
+ * close to the samples keeps the result exact even when the samples
+ * themselves are too large to convert to double without rounding.
+ *
+ * The samples are processed in blocks small enough to stay in the L1
+ * cache: the mean and central moments of each block are computed directly,
+ * which needs no division per sample and can be vectorized, and then
+ * merged into the running totals, so the array is read from memory only
+ * once.
+ *
+ * \param values
+ *      The samples to summarize.
+ * \param count
+ *      Number of samples in values.
+ * \param origin
+ *      Value subtracted from every sample.
+ * \param sum
+ *      If not NULL, the exact sum of the samples (without the origin
+ *      subtracted) is added to this, in the same pass.
+ */
+Moments
+Moments::ofSamples(const uint64_t* values, size_t count, uint64_t origin,
+                   unsigned __int128* sum) {
+    static const size_t blockSize = 512;
+    double diffs[blockSize];
+    Moments total;
+    for (size_t start = 0; start < count; start += blockSize) {
+        size_t length = count - start < blockSize ? count - start : blockSize;
+        double diffSum = 0;
+
+        // The halves of a block's samples are summed separately so that
+        // neither 64-bit sum can overflow.
+        uint64_t lowSum = 0, highSum = 0;
+        for (size_t i = 0; i < length; i++) {
+            uint64_t value = values[start + i];
+            diffs[i] = value >= origin ? static_cast<double>(value - origin)
+                                       : -static_cast<double>(origin - value);
+            diffSum += diffs[i];
+            lowSum += value & 0xffffffff;
+            highSum += value >> 32;
+        }
+        if (sum != NULL)
+            *sum += (static_cast<unsigned __int128>(highSum) << 32) + lowSum;
+        double blockMean = diffSum / static_cast<double>(length);
+        double s2 = 0, s3 = 0, s4 = 0;
+        for (size_t i = 0; i < length; i++) {
+            double d = diffs[i] - blockMean;
+            double d2 = d * d;
+            s2 += d2;
+            s3 += d2 * d;
+            s4 += d2 * d2;
+        }
+
+        Moments block;
+        block.count = length;
+        block.mean = blockMean;
+        block.m2 = s2;
+        block.m3 = s3;
+        block.m4 = s4;
+        total.add(block);
+    }
+    return total;
+}
+
+/**
+ * Combine the values recorded in another accumulator into this one.
+ */
+void
+Moments::add(const Moments& other) {
+    if (other.count == 0)
+        return;
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    double na = static_cast<double>(count);
+    double nb = static_cast<double>(other.count);
+    double n = na + nb;
+    double delta = other.mean - mean;
+    double delta2 = delta * delta;
+    double nab = na * nb;
+
+    double newM2 = m2 + other.m2 + delta2 * nab / n;
+    double newM3 = m3 + other.m3 + delta2 * delta * nab * (na - nb) / (n * n) +
+                   3 * delta * (na * other.m2 - nb * m2) / n;
+    double newM4 = m4 + other.m4 +
+                   delta2 * delta2 * nab * (na * na - nab + nb * nb) /
+                       (n * n * n) +
+                   6 * delta2 * (na * na * other.m2 + nb * nb * m2) / (n * n) +
+                   4 * delta * (na * other.m3 - nb * m3) / n;
+
+    count += other.count;
+    mean += delta * nb / n;
+    m2 = newM2;
+    m3 = newM3;
+    m4 = newM4;
+}
+
+/**
+ * Add delta to every value recorded so far. Only the mean changes.
+ */
+void
+Moments::offset(double delta) {
+    if (count > 0)
+        mean += delta;
+}
+
+/**
+ * Discard all of the values recorded so far.
+ */
+void
+Moments::reset() {
+    *this = Moments();
+}
+
+/**
+ * Return the population variance of the values recorded (the mean squared
+ * difference from the mean), or 0 if there are none.
+ */
+double
+Moments::getVariance() const {
+    if (count == 0)
+        return 0;
+    double variance = m2 / static_cast<double>(count);
+    return variance > 0 ? variance : 0;
+}
+
+/**
+ * Return the population standard deviation of the values recorded.
+ */
+double
+Moments::getStddev() const {
+    return sqrt(getVariance());
+}
+
+/**
+ * Return the skewness of the values recorded: positive when the
+ * distribution has a long upper tail, as latency distributions usually do.
+ * Returns 0 if all of the values are the same.
+ */
+double
+Moments::getSkewness() const {
+    if (count == 0 || m2 <= 0)
+        return 0;
+    double n = static_cast<double>(count);
+    return sqrt(n) * m3 / pow(m2, 1.5);
+}
+
+/**
+ * Return the excess kurtosis of the values recorded: 0 for a normal
+ * distribution, and large when rare outliers dominate the variance.
+ * Returns 0 if all of the values are the same.
+ */
+double
+Moments::getKurtosis() const {
+    if (count == 0 || m2 <= 0)
+        return 0;
+    double n = static_cast<double>(count);
+    return n * m4 / (m2 * m2) - 3;
+}
+
+}  // namespace PerfUtils
@@ -0,0 +1,102 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PERFUTILS_MOMENTS_H
+#define PERFUTILS_MOMENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PerfUtils {
+
+/**
+ * This class accumulates the mean and the second through fourth central
+ * moments of a stream of values in a single pass, from which the variance,
+ * skewness and kurtosis follow. It uses the incremental updates of Welford
+ * and Terriberry, which stay accurate for large values with a small spread
+ * (where summing squares would lose every significant digit), and never
+ * overflow the way integer sums of cycle counts can.
+ *
+ * Accumulators built over separate parts of the data (for example, by
+ * different threads) can be combined with add(), using the pairwise
+ * formulas of Chan et al.; the result is the same, up to rounding, as if
+ * every value had been recorded into one accumulator.
+ *
+ * This class is not thread-safe.
+ */
+class Moments {
+  public:
+    Moments();
+
+    /**
+     * Record a single value.
+     */
+    inline void record(double value) {
+        double n1 = static_cast<double>(count);
+        count++;
+        double n = static_cast<double>(count);
+        double delta = value - mean;
+        double deltaN = delta / n;
+        double deltaN2 = deltaN * deltaN;
+        double term = delta * deltaN * n1;
+        mean += deltaN;
+        m4 += term * deltaN2 * (n * n - 3 * n + 3) + 6 * deltaN2 * m2 -
+              4 * deltaN * m3;
+        m3 += term * deltaN * (n - 2) - 3 * deltaN * m2;
+        m2 += term;
+    }
+
+    void record(double value, uint64_t count);
+    void record(const uint64_t* values, size_t count,
+                unsigned __int128* sum = NULL);
+    void add(const Moments& other);
+    void offset(double delta);
+    void reset();
+
+    static Moments ofSamples(const uint64_t* values, size_t count,
+                             uint64_t origin, unsigned __int128* sum = NULL);
+
+    /// record(const uint64_t*, size_t) summarizes its input in chunks of
+    /// this many samples with ofSamples, and merges the chunks in order.
+    static const size_t CHUNK_SIZE = 65536;
+
+    /// Return the number of values recorded.
+    uint64_t getCount() const { return count; }
+
+    /// Return the mean of the values recorded, or 0 if there are none.
+    double getMean() const { return mean; }
+
+    double getVariance() const;
+    double getStddev() const;
+    double getSkewness() const;
+    double getKurtosis() const;
+
+  private:
+    // Number of values recorded.
+    uint64_t count;
+
+    // Mean of the values recorded.
+    double mean;
+
+    // Sums of the second, third and fourth powers of the differences
+    // between each value and the mean.
+    double m2;
+    double m3;
+    double m4;
+};
+
+}  // namespace PerfUtils
+
+#endif  // PERFUTILS_MOMENTS_H
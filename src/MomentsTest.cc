@@ -0,0 +1,149 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Moments.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::Moments;
+
+// Reference moments computed with the textbook two-pass formulas.
+struct Reference {
+    double mean, variance, skewness, kurtosis;
+};
+
+static Reference
+twoPass(const std::vector<double>& values) {
+    double n = static_cast<double>(values.size());
+    double sum = 0;
+    for (double v : values)
+        sum += v;
+    Reference ref;
+    ref.mean = sum / n;
+    double s2 = 0, s3 = 0, s4 = 0;
+    for (double v : values) {
+        double d = v - ref.mean;
+        s2 += d * d;
+        s3 += d * d * d;
+        s4 += d * d * d * d;
+    }
+    ref.variance = s2 / n;
+    ref.skewness = sqrt(n) * s3 / pow(s2, 1.5);
+    ref.kurtosis = n * s4 / (s2 * s2) - 3;
+    return ref;
+}
+
+TEST(MomentsTest, empty) {
+    Moments moments;
+    EXPECT_EQ(0U, moments.getCount());
+    EXPECT_EQ(0, moments.getMean());
+    EXPECT_EQ(0, moments.getVariance());
+    EXPECT_EQ(0, moments.getSkewness());
+    EXPECT_EQ(0, moments.getKurtosis());
+}
+
+TEST(MomentsTest, matchesTwoPass) {
+    std::vector<double> values;
+    Moments moments;
+    srand(7);
+    for (int i = 0; i < 10000; i++) {
+        // A long upper tail, like a latency distribution.
+        double v = 100 + rand() % 50 + (i % 97 == 0 ? 5000 : 0);
+        values.push_back(v);
+        moments.record(v);
+    }
+    Reference ref = twoPass(values);
+    EXPECT_EQ(10000U, moments.getCount());
+    EXPECT_NEAR(ref.mean, moments.getMean(), 1e-9 * ref.mean);
+    EXPECT_NEAR(ref.variance, moments.getVariance(), 1e-9 * ref.variance);
+    EXPECT_NEAR(ref.skewness, moments.getSkewness(), 1e-9 * ref.skewness);
+    EXPECT_NEAR(ref.kurtosis, moments.getKurtosis(), 1e-9 * ref.kurtosis);
+    EXPECT_GT(moments.getSkewness(), 0);
+}
+
+TEST(MomentsTest, addMatchesSingleAccumulator) {
+    Moments all, first, second, weighted;
+    std::vector<uint64_t> values;
+    for (uint64_t i = 0; i < 3000; i++)
+        values.push_back((i * i) % 1013);
+    for (size_t i = 0; i < values.size(); i++) {
+        all.record(static_cast<double>(values[i]));
+        (i < 1000 ? first : second).record(static_cast<double>(values[i]));
+    }
+    first.add(second);
+    EXPECT_EQ(all.getCount(), first.getCount());
+    EXPECT_NEAR(all.getMean(), first.getMean(), 1e-9);
+    EXPECT_NEAR(all.getVariance(), first.getVariance(), 1e-6);
+    EXPECT_NEAR(all.getSkewness(), first.getSkewness(), 1e-9);
+    EXPECT_NEAR(all.getKurtosis(), first.getKurtosis(), 1e-9);
+
+    Moments blocked;
+    blocked.record(values.data(), values.size());
+    EXPECT_EQ(all.getCount(), blocked.getCount());
+    EXPECT_NEAR(all.getMean(), blocked.getMean(), 1e-9);
+    EXPECT_NEAR(all.getVariance(), blocked.getVariance(), 1e-6);
+    EXPECT_NEAR(all.getKurtosis(), blocked.getKurtosis(), 1e-9);
+
+    // Recording a value with a count is the same as recording it repeatedly.
+    Moments repeated;
+    for (int i = 0; i < 5; i++)
+        repeated.record(3.0);
+    repeated.record(11.0);
+    weighted.record(3.0, 5);
+    weighted.record(11.0, 1);
+    EXPECT_DOUBLE_EQ(repeated.getMean(), weighted.getMean());
+    EXPECT_DOUBLE_EQ(repeated.getVariance(), weighted.getVariance());
+}
+
+TEST(MomentsTest, largeValuesSmallSpread) {
+    // Squaring these values overflows 64-bit integers, and a naive sum of
+    // squares in doubles would lose the spread entirely.
+    Moments moments;
+    std::vector<uint64_t> values;
+    for (uint64_t i = 0; i < 100000; i++)
+        values.push_back((1ULL << 52) + (i % 10) * 1000);
+    moments.record(values.data(), values.size());
+    EXPECT_DOUBLE_EQ(static_cast<double>(1ULL << 52) + 4500,
+                     moments.getMean());
+    EXPECT_NEAR(sqrt(8.25) * 1000, moments.getStddev(), 1e-6);
+    EXPECT_NEAR(0, moments.getSkewness(), 1e-6);
+}
+
+TEST(MomentsTest, exactSum) {
+    // The sum of these does not fit in 64 bits.
+    std::vector<uint64_t> values(100000, ~0ULL);
+    values[0] = 5;
+    unsigned __int128 sum = 0;
+    Moments moments;
+    moments.record(values.data(), values.size(), &sum);
+    EXPECT_TRUE(static_cast<unsigned __int128>(~0ULL) * 99999 + 5 == sum);
+}
+
+TEST(MomentsTest, reset) {
+    Moments moments;
+    moments.record(5.0);
+    moments.record(7.0);
+    moments.reset();
+    EXPECT_EQ(0U, moments.getCount());
+    moments.record(2.0);
+    EXPECT_EQ(2.0, moments.getMean());
+    EXPECT_EQ(0, moments.getVariance());
+}
@@ -14,32 +14,628 @@
  */
 #include "Perf.h"
 
+#include <math.h>
 #include <string.h>
 #include <stdint.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
 
 #include "Cycles.h"
 
 namespace PerfUtils {
 
+    /**
+     * Read the cycle counter at the start of a timed region using the
+     * instruction sequence selected by mode.
+     */
+    template <TimerMode mode>
+    static inline uint64_t startTimer() {
+        return mode == TIMER_SERIALIZED ? Cycles::rdtscFenced()
+                                        : Cycles::rdtsc();
+    }
+
+    /**
+     * Read the cycle counter at the end of a timed region using the
+     * instruction sequence selected by mode.
+     */
+    template <TimerMode mode>
+    static inline uint64_t stopTimer() {
+        return mode == TIMER_SERIALIZED ? Cycles::rdtscpFenced()
+                                        : Cycles::rdtsc();
+    }
+
+    /**
+     * Time numIterations calls to function, storing the cycle count for each
+     * call in latencies.
+     */
+    template <TimerMode mode>
+    static void timeCalls(void (*function)(void), int numIterations,
+                          uint64_t* latencies) {
+        uint64_t startTime;
+        for (int i = 0; i < numIterations; i++) {
+            startTime = startTimer<mode>();
+            function();
+            latencies[i] = stopTimer<mode>() - startTime;
+        }
+    }
+
+    /**
+     * Dispatch to the timeCalls specialization for a runtime mode.
+     */
+    static void timeCalls(void (*function)(void), int numIterations,
+                          uint64_t* latencies, TimerMode mode) {
+        if (mode == TIMER_SERIALIZED)
+            timeCalls<TIMER_SERIALIZED>(function, numIterations, latencies);
+        else
+            timeCalls<TIMER_RDTSC>(function, numIterations, latencies);
+    }
+
+    /**
+     * The function timed by measureOverhead; it is called through a volatile
+     * pointer so that the compiler cannot inline it into the timing loop.
+     */
+    static void emptyFunction() {}
+
     /**
      * Run the given function for numIterations, and compute statistics on the run times.
      */
     Statistics bench(void (*function)(void), int numIterations) {
         uint64_t* latencies = new uint64_t[numIterations];
-        uint64_t startTime;
 
         // Page in the memory
         memset(latencies, 0, numIterations * sizeof(uint64_t));
 
+        timeCalls<TIMER_RDTSC>(function, numIterations, latencies);
+
+        Statistics stats = computeStatistics(latencies, numIterations);
+        delete[] latencies;
+        return stats;
+    }
+
+    /**
+     * Run the given function for numIterations, recording the run times in
+     * a histogram instead of a sample array, so that memory use does not
+     * grow with numIterations.
+     *
+     * \param histogram
+     *      The run times are added to this histogram, in addition to any
+     *      values it already holds.
+     * \return
+     *      Statistics computed from all the values in histogram.
+     */
+    Statistics bench(void (*function)(void), int numIterations,
+                     Histogram* histogram) {
+        uint64_t startTime;
         for (int i = 0; i < numIterations; i++) {
             startTime = Cycles::rdtsc();
             function();
-            latencies[i] = Cycles::rdtsc() - startTime;
+            histogram->record(Cycles::rdtsc() - startTime);
         }
+        return histogram->computeStatistics();
+    }
 
-        Statistics stats = computeStatistics(latencies, numIterations);
+    /**
+     * Run the given function for numIterations using the given timer mode,
+     * and compute statistics on the run times both as measured and with the
+     * timer overhead for that mode subtracted.
+     *
+     * The overhead is calibrated the first time each mode is used; see
+     * measureOverhead.
+     */
+    BenchResult bench(void (*function)(void), int numIterations,
+                      TimerMode mode) {
+        BenchResult result;
+        result.overhead = measureOverhead(mode);
+
+        uint64_t* latencies = new uint64_t[numIterations];
+
+        // Page in the memory
+        memset(latencies, 0, numIterations * sizeof(uint64_t));
+
+        timeCalls(function, numIterations, latencies, mode);
+
+        result.raw = computeStatistics(latencies, numIterations);
+        uint64_t overhead = result.overhead.median;
+        for (int i = 0; i < numIterations; i++)
+            latencies[i] = latencies[i] > overhead ? latencies[i] - overhead
+                                                   : 0;
+        result.corrected = computeStatistics(latencies, numIterations);
         delete[] latencies;
-        return stats;
+        return result;
+    }
+
+    /**
+     * Return the default minimum block time for batchedBench: 100 times
+     * the median cost of reading the counter around a call, and at least
+     * 1000 cycles.
+     */
+    uint64_t defaultBatchCycles() {
+        return std::max<uint64_t>(100 * measureOverhead(TIMER_RDTSC).median,
+                                  1000);
+    }
+
+    /**
+     * Turn the times measured for blocks of batchSize calls into the
+     * per-call results of batchedBench. The times are converted in place.
+     */
+    BatchedResult summarizeBatches(uint64_t* blockTimes, int numSamples,
+                                   int batchSize) {
+        uint64_t overhead = measureOverhead(TIMER_RDTSC).median;
+
+        // The mean and spread come from the block times before they are
+        // rounded, since for calls of a few cycles the spread of the block
+        // means is well under a cycle.
+        Moments moments;
+        for (int i = 0; i < numSamples; i++) {
+            uint64_t time = blockTimes[i] > overhead
+                                ? blockTimes[i] - overhead : 0;
+            moments.record(static_cast<double>(time));
+            blockTimes[i] = (time + batchSize / 2) / batchSize;
+        }
+
+        // The block means vary by the stddev of the block times divided by
+        // batchSize; scaling that by sqrt(batchSize) estimates the stddev
+        // of single calls.
+        double scale = static_cast<double>(batchSize);
+        BatchedResult result;
+        result.perCall = computeStatistics(blockTimes, numSamples);
+        result.average = moments.getMean() / scale;
+        result.callStddev = moments.getStddev() / scale * sqrt(scale);
+        result.batchSize = batchSize;
+        return result;
+    }
+
+    /**
+     * Like the template batchedBench, for a function pointer. Each call is
+     * an indirect call, which is included in the time per call.
+     */
+    BatchedResult batchedBench(void (*function)(void), int numSamples,
+                               uint64_t sampleCycles) {
+        return batchedBench([function]() { function(); }, numSamples,
+                            sampleCycles);
+    }
+
+    /**
+     * Return a core for each of numThreads threads, taken in turn from the
+     * cores that the calling thread may run on. If there are more threads
+     * than cores, the cores are reused from the start.
+     */
+    std::vector<int> spreadOverCores(int numThreads) {
+        cpu_set_t allowed = Util::getCpuAffinity();
+        std::vector<int> available;
+        for (int core = 0; core < CPU_SETSIZE; core++) {
+            if (CPU_ISSET(core, &allowed))
+                available.push_back(core);
+        }
+        std::vector<int> cores;
+        for (int t = 0; t < numThreads; t++)
+            cores.push_back(available.empty()
+                                ? -1 : available[t % available.size()]);
+        return cores;
+    }
+
+    /**
+     * Turn the run times measured by each thread of parallelBench into its
+     * results. The latencies are reordered.
+     */
+    ParallelResult summarizeThreads(
+        std::vector<std::vector<uint64_t>>* latencies,
+        uint64_t elapsedCycles) {
+        ParallelResult result;
+        std::vector<uint64_t> all;
+        for (size_t t = 0; t < latencies->size(); t++) {
+            std::vector<uint64_t>& samples = (*latencies)[t];
+            all.insert(all.end(), samples.begin(), samples.end());
+            result.perThread.push_back(
+                computeStatistics(samples.data(), samples.size()));
+        }
+        result.merged = computeStatistics(all.data(), all.size());
+        result.elapsedCycles = elapsedCycles;
+        double seconds = Cycles::toSeconds(elapsedCycles);
+        result.throughput = seconds > 0
+            ? static_cast<double>(all.size()) / seconds : 0;
+        return result;
+    }
+
+    /**
+     * Turn the number of operations each thread completed in each interval
+     * into the results of throughputBench.
+     *
+     * \param counts
+     *      counts[t][i] is the number of operations thread t completed in
+     *      interval i; every thread has the same number of intervals.
+     * \param intervalCycles
+     *      Length of each interval.
+     */
+    ThroughputResult summarizeThroughput(
+        const std::vector<std::vector<uint64_t>>& counts,
+        uint64_t intervalCycles) {
+        ThroughputResult result;
+        result.intervalSeconds = Cycles::toSeconds(intervalCycles);
+        result.operations = 0;
+        size_t numIntervals = counts.empty() ? 0 : counts[0].size();
+        result.series.assign(numIntervals, 0);
+        for (size_t t = 0; t < counts.size(); t++) {
+            uint64_t total = 0;
+            for (size_t i = 0; i < numIntervals; i++) {
+                total += counts[t][i];
+                result.series[i] += static_cast<double>(counts[t][i]);
+            }
+            result.perThread.push_back(total);
+            result.operations += total;
+        }
+
+        Moments moments;
+        result.min = numIntervals == 0 ? 0 : HUGE_VAL;
+        result.max = 0;
+        for (size_t i = 0; i < numIntervals; i++) {
+            result.series[i] /= result.intervalSeconds;
+            moments.record(result.series[i]);
+            result.min = std::min(result.min, result.series[i]);
+            result.max = std::max(result.max, result.series[i]);
+        }
+        result.mean = moments.getMean();
+        result.variance = moments.getVariance();
+        return result;
+    }
+
+    /**
+     * Return the median of count latencies, reordering them.
+     */
+    static uint64_t medianOf(uint64_t* latencies, int count) {
+        std::nth_element(latencies, latencies + count / 2, latencies + count);
+        return latencies[count / 2];
+    }
+
+    /**
+     * Return the value z such that a standard normal variable lies within
+     * [-z, z] with the given probability.
+     */
+    static double normalInterval(double confidence) {
+        double low = 0;
+        double high = 10;
+        for (int i = 0; i < 64; i++) {
+            double z = (low + high) / 2;
+            if (erfc(z / sqrt(2.0)) > 1 - confidence)
+                low = z;
+            else
+                high = z;
+        }
+        return (low + high) / 2;
+    }
+
+    /**
+     * Compute the value at a quantile of a set of samples, and a
+     * distribution-free confidence interval for it from the order
+     * statistics whose ranks bracket the quantile's rank. Reorders the
+     * samples.
+     *
+     * \return
+     *      False if the interval had to be cut off at the smallest or
+     *      largest sample, which means there are too few samples to bound
+     *      it.
+     */
+    static bool quantileInterval(std::vector<uint64_t>* samples,
+                                 double quantile, double z,
+                                 AdaptiveResult* result) {
+        double n = static_cast<double>(samples->size());
+        double spread = z * sqrt(n * quantile * (1 - quantile));
+        double lowRank = floor(n * quantile - spread);
+        double highRank = ceil(n * quantile + spread);
+        bool bounded = lowRank >= 0 && highRank <= n - 1;
+        lowRank = std::max(lowRank, 0.0);
+        highRank = std::min(highRank, n - 1);
+        size_t rank = std::min(static_cast<size_t>(n * quantile),
+                               samples->size() - 1);
+
+        std::vector<uint64_t>::iterator begin = samples->begin();
+        std::vector<uint64_t>::iterator middle = begin + rank;
+        std::nth_element(begin, middle, samples->end());
+        std::vector<uint64_t>::iterator low =
+            begin + static_cast<size_t>(lowRank);
+        std::vector<uint64_t>::iterator high =
+            begin + static_cast<size_t>(highRank);
+        std::nth_element(begin, low, middle);
+        std::nth_element(middle, high, samples->end());
+        result->quantileValue = *middle;
+        result->lower = *low;
+        result->upper = *high;
+        return bounded;
+    }
+
+    /**
+     * Benchmark a function without choosing an iteration count up front.
+     *
+     * The function is first called in rounds of options.roundSize, and the
+     * rounds are discarded until their median settles, so that cold caches,
+     * page faults and frequency ramp-up do not pollute the results. Samples
+     * are then collected until the confidence interval of options.quantile
+     * is within options.tolerance of its value, or until the time budget or
+     * iteration limit runs out.
+     *
+     * The interval is checked each time the number of samples has grown by
+     * a quarter, so the checks add a constant factor to the run time.
+     */
+    AdaptiveResult adaptiveBench(void (*function)(void),
+                                 const AdaptiveOptions& options) {
+        if (options.maxIterations == 0)
+            PERFUTILS_DIE("adaptiveBench: maxIterations must be positive");
+        AdaptiveResult result;
+        memset(&result, 0, sizeof(result));
+        uint64_t deadline =
+            Cycles::rdtsc() + Cycles::fromSeconds(options.timeBudget);
+        int roundSize = std::max(options.roundSize, 1);
+
+        std::vector<uint64_t> round(roundSize);
+        uint64_t previousMedian = 0;
+        while (result.warmupRounds < options.maxWarmupRounds &&
+               Cycles::rdtsc() < deadline) {
+            timeCalls<TIMER_RDTSC>(function, roundSize, round.data());
+            result.warmupRounds++;
+            result.warmupIterations += roundSize;
+            uint64_t median = medianOf(round.data(), roundSize);
+            double change = fabs(static_cast<double>(median) -
+                                 static_cast<double>(previousMedian));
+            if (result.warmupRounds > 1 &&
+                change <= options.warmupTolerance *
+                              static_cast<double>(previousMedian))
+                break;
+            previousMedian = median;
+        }
+
+        double z = normalInterval(options.confidence);
+        std::vector<uint64_t> samples;
+        std::vector<uint64_t> scratch;
+        size_t nextCheck = 0;
+        do {
+            size_t count = std::min<uint64_t>(
+                roundSize, options.maxIterations - samples.size());
+            size_t start = samples.size();
+            samples.resize(start + count);
+            timeCalls<TIMER_RDTSC>(function, static_cast<int>(count),
+                                   samples.data() + start);
+            if (samples.size() < nextCheck &&
+                samples.size() < options.maxIterations)
+                continue;
+            nextCheck = samples.size() + std::max<size_t>(
+                roundSize, samples.size() / 4);
+            scratch = samples;
+            if (quantileInterval(&scratch, options.quantile, z, &result)) {
+                double halfWidth = static_cast<double>(result.upper -
+                                                       result.lower) / 2;
+                if (halfWidth <= options.tolerance *
+                                 static_cast<double>(result.quantileValue)) {
+                    result.converged = true;
+                    break;
+                }
+            }
+        } while (samples.size() < options.maxIterations &&
+                 Cycles::rdtsc() < deadline);
+
+        if (!result.converged) {
+            scratch = samples;
+            quantileInterval(&scratch, options.quantile, z, &result);
+        }
+        result.numIterations = samples.size();
+        result.stats = computeStatistics(samples.data(), samples.size());
+        return result;
+    }
+
+    /**
+     * Tag the numSuspect slowest of count samples as suspect, or all of
+     * them if numSuspect is at least count.
+     */
+    static void tagSlowest(const uint64_t* latencies, int count,
+                           uint64_t numSuspect, uint8_t* suspect) {
+        if (numSuspect >= static_cast<uint64_t>(count)) {
+            memset(suspect, 1, count);
+            return;
+        }
+        std::vector<int> order(count);
+        for (int i = 0; i < count; i++)
+            order[i] = i;
+        std::nth_element(order.begin(), order.begin() + numSuspect,
+                         order.end(), [latencies](int a, int b) {
+                             return latencies[a] > latencies[b];
+                         });
+        for (uint64_t i = 0; i < numSuspect; i++)
+            suspect[order[i]] = 1;
+    }
+
+    /**
+     * Run the given function for numIterations, like bench, while watching
+     * for interference from the rest of the system, and compute statistics
+     * separately on the samples that may have been inflated by it.
+     *
+     * The calls are timed in batches. Around each batch, outside the timed
+     * region, the thread's context switches are read with getrusage, the
+     * core it runs on is read from TSC_AUX with rdtscp, and optionally the
+     * perf software counters for context switches and migrations are
+     * read. A preemption or migration inflates the one sample it lands in,
+     * so when a batch shows k such events, its k slowest samples are
+     * tagged as suspect. Voluntary switches, where the function itself
+     * blocked, are reported but do not tag samples. Interrupts that do not lead to a context switch,
+     * and SMIs, are invisible to all of these and are not tagged.
+     *
+     * \param options
+     *      The batch size, whether to use the perf counters, and whether
+     *      stats should exclude the suspect samples.
+     */
+    NoiseResult noiseAwareBench(void (*function)(void), int numIterations,
+                                const NoiseOptions& options) {
+        std::vector<PerfCounters::Event> events;
+        if (options.useCounters) {
+            events.push_back(PerfCounters::CONTEXT_SWITCHES);
+            events.push_back(PerfCounters::CPU_MIGRATIONS);
+        }
+        PerfCounters counters(events);
+        int switchIndex = counters.indexOf(PerfCounters::CONTEXT_SWITCHES);
+        int migrationIndex = counters.indexOf(PerfCounters::CPU_MIGRATIONS);
+        uint64_t before[2] = {0, 0};
+        uint64_t after[2] = {0, 0};
+
+        NoiseResult result = NoiseResult();
+        result.counterError = counters.getError();
+        std::vector<uint64_t> latencies(numIterations);
+        std::vector<uint8_t> suspect(numIterations);
+        int batchSize = std::max(options.batchSize, 1);
+        for (int start = 0; start < numIterations; start += batchSize) {
+            int count = std::min(batchSize, numIterations - start);
+            struct rusage usageBefore, usageAfter;
+            uint32_t coreBefore, coreAfter;
+
+            counters.read(before);
+            getrusage(RUSAGE_THREAD, &usageBefore);
+            Cycles::rdtscp(&coreBefore);
+            timeCalls<TIMER_RDTSC>(function, count, &latencies[start]);
+            Cycles::rdtscp(&coreAfter);
+            getrusage(RUSAGE_THREAD, &usageAfter);
+            counters.read(after);
+
+            uint64_t voluntary = usageAfter.ru_nvcsw - usageBefore.ru_nvcsw;
+            uint64_t involuntary =
+                usageAfter.ru_nivcsw - usageBefore.ru_nivcsw;
+            uint64_t coreChanged = coreAfter != coreBefore;
+            uint64_t switches = switchIndex < 0
+                ? 0 : after[switchIndex] - before[switchIndex];
+            uint64_t migrations = migrationIndex < 0
+                ? 0 : after[migrationIndex] - before[migrationIndex];
+            result.voluntarySwitches += voluntary;
+            result.involuntarySwitches += involuntary;
+            result.coreChanges += coreChanged;
+            result.counterSwitches += switches;
+            result.counterMigrations += migrations;
+            result.numBatches++;
+
+            // A voluntary switch is the function blocking on its own, which
+            // makes for a real slow call rather than interference, so only
+            // the other switches are counted. The perf counter sees both
+            // kinds. The sources overlap, so the largest of them is the
+            // best estimate of the number of interruptions.
+            uint64_t preempted = switches > voluntary ? switches - voluntary
+                                                      : 0;
+            uint64_t numSuspect = std::max(
+                std::max(involuntary, preempted),
+                std::max(coreChanged, migrations));
+            if (numSuspect > 0) {
+                result.noisyBatches++;
+                tagSlowest(&latencies[start], count, numSuspect,
+                           &suspect[start]);
+            }
+        }
+
+        std::vector<uint64_t> clean;
+        std::vector<uint64_t> tagged;
+        for (int i = 0; i < numIterations; i++)
+            (suspect[i] ? tagged : clean).push_back(latencies[i]);
+        result.clean = computeStatistics(clean.data(), clean.size());
+        result.suspect = computeStatistics(tagged.data(), tagged.size());
+        result.stats = options.exclude
+            ? result.clean
+            : computeStatistics(latencies.data(), numIterations);
+        return result;
+    }
+
+    /**
+     * Run the given function in numBatches batches of batchSize calls, and
+     * compute statistics on the time per call and on the count of each of
+     * a set of performance counters per call.
+     *
+     * The counters are opened for the calling thread with PerfCounters and
+     * read just outside the timed region of each batch, through rdpmc when
+     * the kernel allows it. Counters that cannot be opened are left out of
+     * the result and described in counterError; if none can be opened, the
+     * timing results are still produced. With small batches the counts
+     * include the cost of reading the cycle counter, so use batches of
+     * many calls for operations of only a few instructions.
+     *
+     * \param events
+     *      The counters to collect; the default is cycles, instructions and
+     *      LLC, branch and data TLB misses.
+     */
+    CounterBenchResult benchWithCounters(
+        void (*function)(void), int numBatches, int batchSize,
+        const std::vector<PerfCounters::Event>& events) {
+        PerfCounters counters(events);
+        size_t numCounters = counters.getNumCounters();
+        std::vector<uint64_t> times(numBatches);
+        std::vector<uint64_t> counts(numBatches * numCounters);
+        std::vector<uint64_t> before(numCounters);
+        std::vector<uint64_t> after(numCounters);
+
+        for (int i = 0; i < numBatches; i++) {
+            counters.read(before.data());
+            uint64_t startTime = Cycles::rdtsc();
+            for (int j = 0; j < batchSize; j++)
+                function();
+            uint64_t stopTime = Cycles::rdtsc();
+            counters.read(after.data());
+            times[i] = stopTime - startTime;
+            for (size_t c = 0; c < numCounters; c++)
+                counts[c * numBatches + i] = after[c] - before[c];
+        }
+
+        CounterBenchResult result;
+        result.counterError = counters.getError();
+        std::vector<double> totals(numCounters);
+        for (size_t c = 0; c < numCounters; c++) {
+            uint64_t* batches = counts.data() + c * numBatches;
+            for (int i = 0; i < numBatches; i++) {
+                totals[c] += static_cast<double>(batches[i]);
+                batches[i] = (batches[i] + batchSize / 2) / batchSize;
+            }
+            CounterStatistics stats;
+            stats.event = counters.getEvent(c);
+            stats.perIteration = computeStatistics(batches, numBatches);
+            stats.average = totals[c] /
+                            (static_cast<double>(numBatches) * batchSize);
+            result.counters.push_back(stats);
+        }
+        for (int i = 0; i < numBatches; i++)
+            times[i] = (times[i] + batchSize / 2) / batchSize;
+        result.time = computeStatistics(times.data(), numBatches);
+
+        int cycles = counters.indexOf(PerfCounters::CYCLES);
+        int instructions = counters.indexOf(PerfCounters::INSTRUCTIONS);
+        result.ipc = cycles >= 0 && instructions >= 0 && totals[cycles] > 0
+                         ? totals[instructions] / totals[cycles] : 0;
+        return result;
+    }
+
+    /**
+     * Return the distribution of times that bench measures for a function
+     * that does nothing, using the given timer mode. This captures the cost
+     * of the counter reads themselves plus the indirect call, and is what
+     * bench subtracts to produce corrected statistics.
+     *
+     * The measurement is taken once per mode, on first use, and cached for
+     * the life of the process.
+     */
+    Statistics measureOverhead(TimerMode mode) {
+        static const int NUM_CALIBRATION_ITERATIONS = 100000;
+        static std::once_flag calibrated[2];
+        static Statistics overheads[2];
+
+        std::call_once(calibrated[mode], [mode] {
+            void (*volatile function)(void) = emptyFunction;
+            uint64_t* latencies = new uint64_t[NUM_CALIBRATION_ITERATIONS];
+            memset(latencies, 0,
+                   NUM_CALIBRATION_ITERATIONS * sizeof(uint64_t));
+
+            // Discard a first pass so that the caches and branch predictors
+            // are warm for the pass that is kept.
+            timeCalls(function, NUM_CALIBRATION_ITERATIONS, latencies, mode);
+            timeCalls(function, NUM_CALIBRATION_ITERATIONS, latencies, mode);
+            overheads[mode] =
+                computeStatistics(latencies, NUM_CALIBRATION_ITERATIONS);
+            delete[] latencies;
+        });
+        return overheads[mode];
     }
 
     /**
@@ -60,4 +656,252 @@ namespace PerfUtils {
         delete[] latencies;
         return stats;
     }
+
+    /**
+     * Run the given function for numIterations, recording the times reported
+     * by the function itself in a histogram instead of a sample array.
+     *
+     * \param histogram
+     *      The reported times are added to this histogram, in addition to any
+     *      values it already holds.
+     * \return
+     *      Statistics computed from all the values in histogram.
+     */
+    Statistics manualBench(void (*function)(uint64_t*), int numIterations,
+                           Histogram* histogram) {
+        uint64_t latency;
+        for (int i = 0; i < numIterations; i++) {
+            function(&latency);
+            histogram->record(latency);
+        }
+        return histogram->computeStatistics();
+    }
+
+    /**
+     * Number of samples that streamingBench and streamingManualBench
+     * collect before folding them into their summaries; small enough to
+     * stay in the L1 cache.
+     */
+    static const size_t STREAMING_BLOCK_SIZE = 4096;
+
+    /**
+     * Fold a block of samples into the summaries of a streaming run.
+     */
+    static void recordBlock(const uint64_t* latencies, size_t count,
+                            StreamingResult* result, Reservoir* reservoir) {
+        for (size_t i = 0; i < count; i++)
+            result->histogram.record(latencies[i]);
+        result->moments.record(latencies, count);
+        reservoir->record(latencies, count);
+    }
+
+    /**
+     * Compute the statistics of a streaming run once all its blocks have
+     * been recorded.
+     */
+    static void finishStreaming(StreamingResult* result,
+                                const Reservoir& reservoir) {
+        result->stats = result->histogram.computeStatistics();
+        result->stats.average =
+            static_cast<uint64_t>(result->moments.getMean());
+        result->stats.stddev =
+            static_cast<uint64_t>(result->moments.getStddev());
+        result->reservoir = reservoir.getSamples();
+    }
+
+    /**
+     * Run the given function for numIterations, and compute statistics on
+     * the run times using memory that does not depend on numIterations,
+     * so that runs of billions of iterations are possible.
+     *
+     * Times are collected in a small block and then folded into a
+     * histogram, which provides the quantiles to 3 significant digits,
+     * and into exact moments, which provide the mean and variance.
+     *
+     * \param numIterations
+     *      Number of calls to time.
+     * \param reservoirSize
+     *      Number of raw times to keep, chosen uniformly at random from the
+     *      whole run, for later analysis; 0 keeps none.
+     */
+    StreamingResult streamingBench(void (*function)(void),
+                                   uint64_t numIterations,
+                                   size_t reservoirSize) {
+        StreamingResult result;
+        Reservoir reservoir(reservoirSize);
+        uint64_t latencies[STREAMING_BLOCK_SIZE];
+        uint64_t startTime;
+        for (uint64_t done = 0; done < numIterations;) {
+            size_t count = numIterations - done < STREAMING_BLOCK_SIZE
+                               ? numIterations - done : STREAMING_BLOCK_SIZE;
+            for (size_t i = 0; i < count; i++) {
+                startTime = Cycles::rdtsc();
+                function();
+                latencies[i] = Cycles::rdtsc() - startTime;
+            }
+            recordBlock(latencies, count, &result, &reservoir);
+            done += count;
+        }
+        finishStreaming(&result, reservoir);
+        return result;
+    }
+
+    /**
+     * Like streamingBench, but using the times reported by the function
+     * itself, as in manualBench.
+     */
+    StreamingResult streamingManualBench(void (*function)(uint64_t*),
+                                         uint64_t numIterations,
+                                         size_t reservoirSize) {
+        StreamingResult result;
+        Reservoir reservoir(reservoirSize);
+        uint64_t latencies[STREAMING_BLOCK_SIZE];
+        for (uint64_t done = 0; done < numIterations;) {
+            size_t count = numIterations - done < STREAMING_BLOCK_SIZE
+                               ? numIterations - done : STREAMING_BLOCK_SIZE;
+            for (size_t i = 0; i < count; i++)
+                function(&latencies[i]);
+            recordBlock(latencies, count, &result, &reservoir);
+            done += count;
+        }
+        finishStreaming(&result, reservoir);
+        return result;
+    }
+
+    /**
+     * Compute raw statistics and statistics corrected for coordinated
+     * omission over a set of latencies.
+     */
+    static IntervalResult correctForOmission(uint64_t* latencies,
+                                             int numIterations,
+                                             uint64_t expectedInterval) {
+        IntervalResult result;
+        Histogram corrected;
+        for (int i = 0; i < numIterations; i++)
+            corrected.recordWithExpectedInterval(latencies[i],
+                                                 expectedInterval);
+        result.corrected = corrected.computeStatistics();
+        result.raw = computeStatistics(latencies, numIterations);
+        return result;
+    }
+
+    /**
+     * Run the given function for numIterations, and compute statistics on
+     * the run times both as measured and corrected for coordinated
+     * omission.
+     *
+     * bench calls the function back to back, so a stall of many intervals
+     * shows up as a single slow sample. If the function stands for a
+     * request that, in real use, arrives every expectedInterval cycles, all
+     * the requests that would have arrived during the stall would have been
+     * delayed by it too. The corrected statistics include those requests.
+     *
+     * \param expectedInterval
+     *      Intended time between calls, in cycles.
+     */
+    IntervalResult benchWithInterval(void (*function)(void),
+                                     int numIterations,
+                                     uint64_t expectedInterval) {
+        uint64_t* latencies = new uint64_t[numIterations];
+
+        // Page in the memory
+        memset(latencies, 0, numIterations * sizeof(uint64_t));
+
+        timeCalls<TIMER_RDTSC>(function, numIterations, latencies);
+
+        IntervalResult result =
+            correctForOmission(latencies, numIterations, expectedInterval);
+        delete[] latencies;
+        return result;
+    }
+
+    /**
+     * Like benchWithInterval, but using the times reported by the function
+     * itself, as in manualBench.
+     *
+     * \param expectedInterval
+     *      Intended time between calls, in the unit the function reports.
+     */
+    IntervalResult manualBenchWithInterval(void (*function)(uint64_t*),
+                                           int numIterations,
+                                           uint64_t expectedInterval) {
+        uint64_t* latencies = new uint64_t[numIterations];
+
+        // Page in the memory
+        memset(latencies, 0, numIterations * sizeof(uint64_t));
+        for (int i = 0; i < numIterations; i++) {
+            function(&latencies[i]);
+        }
+
+        IntervalResult result =
+            correctForOmission(latencies, numIterations, expectedInterval);
+        delete[] latencies;
+        return result;
+    }
+
+    /**
+     * Measure how long it takes to hand a cache line from one core to
+     * another. Two threads, pinned to coreA and coreB, take turns writing
+     * a counter in a shared cache line, each waiting to see the other's
+     * write before making its own. The thread on coreA times each round
+     * trip; half of it is the one-way latency.
+     *
+     * \param coreA
+     *      Core for the thread that times the round trips; -1 leaves it
+     *      unpinned.
+     * \param coreB
+     *      Core for the thread that answers; -1 leaves it unpinned.
+     * \param numRoundTrips
+     *      Number of round trips timed, after a tenth as many untimed ones
+     *      to warm up.
+     * \return
+     *      Statistics on the one-way latency, in cycles.
+     */
+    Statistics coreToCoreLatency(int coreA, int coreB, int numRoundTrips) {
+        struct SharedLine {
+            std::atomic<uint64_t> value;
+        };
+        SharedLine* line =
+            new (Util::cacheAlignAlloc(sizeof(SharedLine))) SharedLine;
+        line->value = 0;
+        uint64_t warmup = numRoundTrips / 10;
+        uint64_t total = warmup + numRoundTrips;
+        uint64_t* latencies = new uint64_t[numRoundTrips];
+
+        // Page in the memory
+        memset(latencies, 0, numRoundTrips * sizeof(uint64_t));
+
+        std::thread answerer([=] {
+            if (coreB >= 0)
+                Util::pinThreadToCore(coreB);
+            for (uint64_t i = 0; i < total; i++) {
+                while (line->value.load(std::memory_order_acquire) !=
+                       2 * i + 1)
+                    _mm_pause();
+                line->value.store(2 * i + 2, std::memory_order_release);
+            }
+        });
+        std::thread timer([=] {
+            if (coreA >= 0)
+                Util::pinThreadToCore(coreA);
+            for (uint64_t i = 0; i < total; i++) {
+                uint64_t startTime = Cycles::rdtsc();
+                line->value.store(2 * i + 1, std::memory_order_release);
+                while (line->value.load(std::memory_order_acquire) !=
+                       2 * i + 2)
+                    _mm_pause();
+                if (i >= warmup)
+                    latencies[i - warmup] =
+                        (Cycles::rdtsc() - startTime) / 2;
+            }
+        });
+        timer.join();
+        answerer.join();
+
+        Statistics stats = computeStatistics(latencies, numRoundTrips);
+        delete[] latencies;
+        line->~SharedLine();
+        free(line);
+        return stats;
+    }
 }
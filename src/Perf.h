@@ -12,8 +12,709 @@
  * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
+#ifndef PERFUTILS_PERF_H
+#define PERFUTILS_PERF_H
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Cycles.h"
+#include "Histogram.h"
+#include "PerfCounters.h"
+#include "Reservoir.h"
 #include "Stats.h"
+#include "Util.h"
 namespace PerfUtils {
+    /**
+     * Force the compiler to assume that value is read, so that the
+     * computation producing it cannot be removed as dead code. Use this on
+     * results inside a benchmarked callable.
+     */
+    template <typename T>
+    inline __attribute__((always_inline)) void doNotOptimize(
+        const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    /**
+     * True if a T can be held in a general-purpose register.
+     */
+    template <typename T>
+    struct FitsInRegister {
+        static const bool value = std::is_trivially_copyable<T>::value &&
+                                  sizeof(T) <= sizeof(uint64_t);
+    };
+
+    /**
+     * Force the compiler to assume that value is both read and modified, so
+     * that it can neither remove the computation producing it nor hoist
+     * that computation out of the timing loop as a constant.
+     */
+    template <typename T>
+    inline __attribute__((always_inline))
+    typename std::enable_if<FitsInRegister<T>::value>::type
+    doNotOptimize(T& value) {
+        asm volatile("" : "+r"(value) : : "memory");
+    }
+
+    /**
+     * Like doNotOptimize above, for values that do not fit in a register.
+     * GCC miscompiles an in-out operand with a choice of register or memory
+     * at higher optimization levels, so each case gets one constraint.
+     */
+    template <typename T>
+    inline __attribute__((always_inline))
+    typename std::enable_if<!FitsInRegister<T>::value>::type
+    doNotOptimize(T& value) {
+        asm volatile("" : "+m"(value) : : "memory");
+    }
+
+    /**
+     * Force the compiler to assume that all memory is read and written
+     * here, so that stores made by a benchmarked callable are not elided
+     * or moved past this point.
+     */
+    inline __attribute__((always_inline)) void clobberMemory() {
+        asm volatile("" : : : "memory");
+    }
+
+    /**
+     * Selects the instruction sequence that bench uses to read the cycle
+     * counter on either side of each call.
+     */
+    enum TimerMode {
+        // A bare rdtsc on each side. This is the cheapest option, but the
+        // processor may reorder the reads with the code being measured.
+        TIMER_RDTSC,
+
+        // lfence;rdtsc before the call and rdtscp;lfence after it, so that
+        // only the measured call executes between the two reads.
+        TIMER_SERIALIZED
+    };
+
+    /**
+     * Results of a bench run that accounts for the cost of timing itself.
+     */
+    struct BenchResult {
+        // Statistics on the measured times, exactly as read from the clock.
+        Statistics raw;
+
+        // Statistics on the measured times after subtracting the median
+        // timer overhead from each sample (clamped at zero).
+        Statistics corrected;
+
+        // Statistics on the times measured for an empty function called
+        // through the same path; see measureOverhead.
+        Statistics overhead;
+    };
+
+    /**
+     * Results of a bench run corrected for coordinated omission; see
+     * benchWithInterval.
+     */
+    struct IntervalResult {
+        // Statistics on the times measured, one sample per call.
+        Statistics raw;
+
+        // Statistics after adding the samples that a stall would have
+        // delayed under the intended load; see
+        // Histogram::recordWithExpectedInterval. These come from a histogram
+        // with 3 significant digits.
+        Statistics corrected;
+    };
+
+    /**
+     * Parameters for adaptiveBench.
+     */
+    struct AdaptiveOptions {
+        AdaptiveOptions()
+            : quantile(0.99),
+              tolerance(0.01),
+              confidence(0.95),
+              timeBudget(1.0),
+              roundSize(1000),
+              warmupTolerance(0.05),
+              maxWarmupRounds(100),
+              maxIterations(10000000) {}
+
+        // Quantile whose confidence interval decides when to stop.
+        double quantile;
+
+        // Sampling stops once the half-width of the confidence interval of
+        // the quantile is at most this fraction of its value.
+        double tolerance;
+
+        // Coverage of that confidence interval.
+        double confidence;
+
+        // Seconds after which the run stops even if it has not converged,
+        // counting the warm-up.
+        double timeBudget;
+
+        // Number of calls timed between checks.
+        int roundSize;
+
+        // The warm-up ends once the median of a round is within this
+        // fraction of the median of the round before it.
+        double warmupTolerance;
+
+        // Upper limit on the number of warm-up rounds.
+        int maxWarmupRounds;
+
+        // Upper limit on the number of samples kept; this bounds the memory
+        // used at 8 bytes per sample. Must be positive.
+        uint64_t maxIterations;
+    };
+
+    /**
+     * Results of adaptiveBench.
+     */
+    struct AdaptiveResult {
+        // Statistics on the samples taken after the warm-up.
+        Statistics stats;
+
+        // The target quantile and the bounds of its confidence interval.
+        uint64_t quantileValue;
+        uint64_t lower;
+        uint64_t upper;
+
+        // Number of samples in stats.
+        uint64_t numIterations;
+
+        // Number of rounds, and calls, discarded as warm-up.
+        int warmupRounds;
+        uint64_t warmupIterations;
+
+        // True if the interval reached the tolerance; false if the time
+        // budget or iteration limit ran out first.
+        bool converged;
+    };
+
+    /**
+     * Results of batchedBench.
+     */
+    struct BatchedResult {
+        // Statistics on the time per call: each sample is the time for a
+        // block of batchSize calls, less the timer overhead, divided by
+        // batchSize and rounded to the nearest cycle.
+        //
+        // Each sample is the mean of batchSize calls, so the spread of
+        // these statistics is that of block means, not of single calls:
+        // the standard deviation shrinks by about sqrt(batchSize), and the
+        // tail quantiles hide outlying calls inside their blocks. Use bench
+        // when the distribution of single calls matters.
+        Statistics perCall;
+
+        // Mean time per call in cycles, without rounding; for calls that
+        // take only a few cycles this is more precise than perCall.average.
+        double average;
+
+        // The standard deviation of the unrounded block means, scaled back
+        // up by sqrt(batchSize); an estimate of the standard deviation of
+        // single calls, assuming that calls vary independently.
+        double callStddev;
+
+        // Number of calls timed per sample.
+        int batchSize;
+    };
+
+    /**
+     * Results of parallelBench.
+     */
+    struct ParallelResult {
+        // Statistics on the run times measured by each thread, in the
+        // order of the cores the threads were given.
+        std::vector<Statistics> perThread;
+
+        // Statistics on the run times of all the threads together.
+        Statistics merged;
+
+        // Cycles from the common start until the last thread finished.
+        uint64_t elapsedCycles;
+
+        // Calls completed per second by all the threads together, over
+        // elapsedCycles.
+        double throughput;
+    };
+
+    /**
+     * Statistics on one hardware or software counter; see
+     * benchWithCounters.
+     */
+    struct CounterStatistics {
+        PerfCounters::Event event;
+
+        // Statistics on the count per call, one sample per batch, rounded
+        // to the nearest integer.
+        Statistics perIteration;
+
+        // Mean count per call, without rounding.
+        double average;
+    };
+
+    /**
+     * Results of benchWithCounters.
+     */
+    struct CounterBenchResult {
+        // Statistics on the time per call in cycles, one sample per batch.
+        Statistics time;
+
+        // One entry per counter that could be opened; empty if none could.
+        std::vector<CounterStatistics> counters;
+
+        // Instructions per cycle over the whole run, or 0 if the cycle or
+        // instruction counter is not available.
+        double ipc;
+
+        // Why some counters are missing; see PerfCounters::getError.
+        std::string counterError;
+    };
+
+    /**
+     * Results of throughputBench and parallelThroughputBench.
+     */
+    struct ThroughputResult {
+        // Operations per second completed in each interval, by all the
+        // threads together.
+        std::vector<double> series;
+
+        // Mean, variance, minimum and maximum of the values in series.
+        double mean;
+        double variance;
+        double min;
+        double max;
+
+        // Total number of operations completed, and the number completed
+        // by each thread.
+        uint64_t operations;
+        std::vector<uint64_t> perThread;
+
+        // Length of each interval, in seconds.
+        double intervalSeconds;
+    };
+
+    /**
+     * Results of streamingBench and streamingManualBench.
+     */
+    struct StreamingResult {
+        // Statistics computed from histogram, except that average and
+        // stddev come from moments and so are exact.
+        Statistics stats;
+
+        // Exact count, mean, variance, skewness and kurtosis of all the
+        // samples.
+        Moments moments;
+
+        // Distribution of all the samples, with 3 significant digits.
+        Histogram histogram;
+
+        // A uniform random sample of the raw values, at most as many as
+        // were requested, in no particular order.
+        std::vector<uint64_t> reservoir;
+    };
+
+    /**
+     * Parameters for noiseAwareBench.
+     */
+    struct NoiseOptions {
+        NoiseOptions()
+            : batchSize(1000),
+              useCounters(false),
+              exclude(false) {}
+
+        // Number of calls between checks for interference. Smaller batches
+        // pin down the suspect samples more closely, at the cost of more
+        // system calls between them.
+        int batchSize;
+
+        // If true, also count context switches and migrations with the
+        // perf software counters, which see switches that getrusage can
+        // miss, such as those to the idle task on the same core.
+        bool useCounters;
+
+        // If true, stats is computed from the clean samples only.
+        bool exclude;
+    };
+
+    /**
+     * Results of noiseAwareBench.
+     */
+    struct NoiseResult {
+        // Statistics on the clean samples if NoiseOptions::exclude is set,
+        // and on all the samples otherwise.
+        Statistics stats;
+
+        // Statistics on the samples that were not tagged, and on those
+        // that were.
+        Statistics clean;
+        Statistics suspect;
+
+        // Number of batches, and number in which interference was seen.
+        int numBatches;
+        int noisyBatches;
+
+        // Totals over the run of each sign of interference: voluntary and
+        // involuntary context switches from getrusage, batches that ended
+        // on a different core than they started on according to TSC_AUX,
+        // and the perf software counts of context switches and migrations
+        // (0 unless NoiseOptions::useCounters is set). Voluntary switches
+        // are the function blocking, and do not make samples suspect.
+        uint64_t voluntarySwitches;
+        uint64_t involuntarySwitches;
+        uint64_t coreChanges;
+        uint64_t counterSwitches;
+        uint64_t counterMigrations;
+
+        // Why the perf counters could not be opened, if they could not.
+        std::string counterError;
+    };
+
     Statistics bench(void (*function)(void), int numIterations);
+    BenchResult bench(void (*function)(void), int numIterations,
+                      TimerMode mode);
+    Statistics bench(void (*function)(void), int numIterations,
+                     Histogram* histogram);
     Statistics manualBench(void (*function)(uint64_t*), int numIterations);
+    Statistics manualBench(void (*function)(uint64_t*), int numIterations,
+                           Histogram* histogram);
+    StreamingResult streamingBench(void (*function)(void),
+                                   uint64_t numIterations,
+                                   size_t reservoirSize = 0);
+    StreamingResult streamingManualBench(void (*function)(uint64_t*),
+                                         uint64_t numIterations,
+                                         size_t reservoirSize = 0);
+    IntervalResult benchWithInterval(void (*function)(void),
+                                     int numIterations,
+                                     uint64_t expectedInterval);
+    IntervalResult manualBenchWithInterval(void (*function)(uint64_t*),
+                                           int numIterations,
+                                           uint64_t expectedInterval);
+    /**
+     * Run the given callable for numIterations, and compute statistics on
+     * the run times.
+     *
+     * Unlike bench on a function pointer, the callable is a template
+     * parameter, so a lambda is inlined into the timing loop and the
+     * samples do not include the cost of an indirect call. Use
+     * doNotOptimize and clobberMemory inside it to keep the compiler from
+     * removing the work being measured. Plain function pointers still go
+     * to the non-template overload.
+     */
+    template <typename Function>
+    Statistics bench(Function&& function, int numIterations) {
+        uint64_t* latencies = new uint64_t[numIterations];
+
+        // Page in the memory
+        memset(latencies, 0, numIterations * sizeof(uint64_t));
+
+        uint64_t startTime;
+        for (int i = 0; i < numIterations; i++) {
+            startTime = Cycles::rdtsc();
+            function();
+            latencies[i] = Cycles::rdtsc() - startTime;
+        }
+
+        Statistics stats = computeStatistics(latencies, numIterations);
+        delete[] latencies;
+        return stats;
+    }
+
+    uint64_t defaultBatchCycles();
+    BatchedResult summarizeBatches(uint64_t* blockTimes, int numSamples,
+                                   int batchSize);
+
+    /**
+     * Benchmark an operation too short to time one call at a time, by
+     * timing blocks of calls and reporting the time per call; see
+     * BatchedResult for how this affects the spread of the results.
+     *
+     * The block size is chosen by doubling it until a block takes at least
+     * sampleCycles, so that the cost and resolution of reading the counter
+     * are small relative to each sample.
+     *
+     * \param function
+     *      A callable; as with the template bench, it is inlined into the
+     *      timing loop.
+     * \param numSamples
+     *      Number of blocks to time.
+     * \param sampleCycles
+     *      Minimum time per block; 0 selects defaultBatchCycles.
+     */
+    template <typename Function>
+    BatchedResult batchedBench(Function&& function, int numSamples,
+                               uint64_t sampleCycles = 0) {
+        if (sampleCycles == 0)
+            sampleCycles = defaultBatchCycles();
+        int batchSize = 1;
+        while (batchSize < (1 << 30)) {
+            uint64_t startTime = Cycles::rdtsc();
+            for (int j = 0; j < batchSize; j++)
+                function();
+            if (Cycles::rdtsc() - startTime >= sampleCycles)
+                break;
+            batchSize *= 2;
+        }
+
+        uint64_t* blockTimes = new uint64_t[numSamples];
+
+        // Page in the memory
+        memset(blockTimes, 0, numSamples * sizeof(uint64_t));
+
+        uint64_t startTime;
+        for (int i = 0; i < numSamples; i++) {
+            startTime = Cycles::rdtsc();
+            for (int j = 0; j < batchSize; j++)
+                function();
+            blockTimes[i] = Cycles::rdtsc() - startTime;
+        }
+
+        BatchedResult result =
+            summarizeBatches(blockTimes, numSamples, batchSize);
+        delete[] blockTimes;
+        return result;
+    }
+
+    BatchedResult batchedBench(void (*function)(void), int numSamples,
+                               uint64_t sampleCycles = 0);
+    std::vector<int> spreadOverCores(int numThreads);
+    ParallelResult summarizeThreads(
+        std::vector<std::vector<uint64_t>>* latencies,
+        uint64_t elapsedCycles);
+
+    /**
+     * Run a callable on one thread per entry of cores, with all of the
+     * threads starting on the same cycle counter tick.
+     *
+     * Each thread pins itself and calls prepare, for setup such as paging
+     * in memory that should not overlap the others' run, then waits at a
+     * spin barrier. Once all are ready, they are given a start time
+     * slightly in the future and spin on the cycle counter until it
+     * arrives before calling body.
+     *
+     * \param cores
+     *      The core for each thread; a negative entry leaves that thread
+     *      unpinned.
+     * \param prepare
+     *      A callable taking the index of the calling thread, from 0 to
+     *      cores.size() - 1.
+     * \param body
+     *      A callable taking the index of the calling thread and the start
+     *      time.
+     * \return
+     *      The start time, once all of the threads have finished.
+     */
+    template <typename Prepare, typename Body>
+    uint64_t runOnCores(const std::vector<int>& cores, Prepare&& prepare,
+                        Body&& body) {
+        size_t numThreads = cores.size();
+        std::atomic<size_t> ready(0);
+        std::atomic<uint64_t> startTime(0);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < numThreads; t++) {
+            threads.emplace_back([&, t] {
+                if (cores[t] >= 0)
+                    Util::pinThreadToCore(cores[t]);
+                int thread = static_cast<int>(t);
+                prepare(thread);
+                ready++;
+
+                uint64_t start;
+                while ((start = startTime.load()) == 0)
+                    _mm_pause();
+                while (Cycles::rdtsc() < start)
+                    _mm_pause();
+                body(thread, start);
+            });
+        }
+        while (ready.load() < numThreads)
+            std::this_thread::yield();
+        uint64_t start = Cycles::rdtsc() + Cycles::fromMicroseconds(100);
+        startTime.store(start);
+        for (size_t t = 0; t < numThreads; t++)
+            threads[t].join();
+        return start;
+    }
+
+    /**
+     * Run the given callable for numIterations on each of several threads
+     * at once, one pinned to each of the given cores, and compute
+     * statistics on the run times of each thread and of all of them.
+     *
+     * The threads are started with runOnCores, after paging in their
+     * sample arrays, so that all of them begin on the same tick.
+     *
+     * \param function
+     *      A callable taking the index of the calling thread, from 0 to
+     *      cores.size() - 1; it is inlined into each thread's timing loop.
+     * \param numIterations
+     *      Number of calls made by each thread.
+     * \param cores
+     *      The core for each thread; a negative entry leaves that thread
+     *      unpinned.
+     */
+    template <typename Function>
+    ParallelResult parallelBench(Function&& function, int numIterations,
+                                 const std::vector<int>& cores) {
+        size_t numThreads = cores.size();
+        std::vector<std::vector<uint64_t>> latencies(numThreads);
+        std::vector<uint64_t> endTimes(numThreads);
+        uint64_t start = runOnCores(cores,
+            [&](int thread) {
+                // Page in the memory on the core that will write it.
+                latencies[thread].assign(numIterations, 0);
+            },
+            [&](int thread, uint64_t) {
+                uint64_t* samples = latencies[thread].data();
+                uint64_t callStart;
+                for (int i = 0; i < numIterations; i++) {
+                    callStart = Cycles::rdtsc();
+                    function(thread);
+                    samples[i] = Cycles::rdtsc() - callStart;
+                }
+                endTimes[thread] = Cycles::rdtsc();
+            });
+
+        uint64_t end = start;
+        for (size_t t = 0; t < numThreads; t++)
+            end = endTimes[t] > end ? endTimes[t] : end;
+        return summarizeThreads(&latencies, end - start);
+    }
+
+    /**
+     * Like parallelBench on a list of cores, but with numThreads threads
+     * spread over the cores the calling thread may run on; see
+     * spreadOverCores.
+     */
+    template <typename Function>
+    ParallelResult parallelBench(Function&& function, int numIterations,
+                                 int numThreads) {
+        return parallelBench(function, numIterations,
+                             spreadOverCores(numThreads));
+    }
+
+    ThroughputResult summarizeThroughput(
+        const std::vector<std::vector<uint64_t>>& counts,
+        uint64_t intervalCycles);
+
+    /**
+     * Call function repeatedly until numIntervals intervals of
+     * intervalCycles, starting at start, have passed, and store the number
+     * of calls completed in each interval in counts.
+     *
+     * The cycle counter is read once every few calls, and the number of
+     * calls between reads grows until the reads are about a thousandth of
+     * an interval apart, so the timing costs little even for very short
+     * operations and the interval boundaries stay accurate.
+     */
+    template <typename Function>
+    void countOperations(Function&& function, uint64_t start,
+                         uint64_t intervalCycles, size_t numIntervals,
+                         uint64_t* counts) {
+        const uint64_t maxPeriod = 1 << 20;
+        uint64_t period = 1;
+        uint64_t operations = 0;
+        uint64_t previous = 0;
+        uint64_t lastCheck = start;
+        uint64_t intervalEnd = start + intervalCycles;
+        size_t interval = 0;
+        while (interval < numIntervals) {
+            for (uint64_t i = 0; i < period; i++)
+                function();
+            operations += period;
+            uint64_t now = Cycles::rdtsc();
+            while (now >= intervalEnd && interval < numIntervals) {
+                counts[interval++] = operations - previous;
+                previous = operations;
+                intervalEnd += intervalCycles;
+            }
+            if (now - lastCheck < intervalCycles / 1000 && period < maxPeriod)
+                period *= 2;
+            lastCheck = now;
+        }
+    }
+
+    /**
+     * Call the given callable as often as possible for a fixed length of
+     * time, and report the number of operations completed per second in
+     * each interval of that time, along with the mean, variance and
+     * minimum of those rates.
+     *
+     * \param function
+     *      A callable performing one operation; it is inlined into the
+     *      loop.
+     * \param seconds
+     *      How long to run, rounded to a whole number of intervals.
+     * \param intervalSeconds
+     *      Length of each interval in the time series.
+     */
+    template <typename Function>
+    ThroughputResult throughputBench(Function&& function, double seconds,
+                                     double intervalSeconds = 0.1) {
+        uint64_t intervalCycles = Cycles::fromSeconds(intervalSeconds);
+        size_t numIntervals = std::max<size_t>(
+            static_cast<size_t>(seconds / intervalSeconds + 0.5), 1);
+        std::vector<std::vector<uint64_t>> counts(
+            1, std::vector<uint64_t>(numIntervals));
+        countOperations(function, Cycles::rdtsc(), intervalCycles,
+                        numIntervals, counts[0].data());
+        return summarizeThroughput(counts, intervalCycles);
+    }
+
+    /**
+     * Like throughputBench, but with one thread on each of the given cores
+     * calling the callable at once; the series gives the operations
+     * completed by all of them. As in parallelBench, the threads pin
+     * themselves and start on the same cycle counter tick.
+     *
+     * \param function
+     *      A callable taking the index of the calling thread, from 0 to
+     *      cores.size() - 1.
+     * \param seconds
+     *      How long to run, rounded to a whole number of intervals.
+     * \param cores
+     *      The core for each thread; a negative entry leaves that thread
+     *      unpinned.
+     * \param intervalSeconds
+     *      Length of each interval in the time series.
+     */
+    template <typename Function>
+    ThroughputResult parallelThroughputBench(Function&& function,
+                                             double seconds,
+                                             const std::vector<int>& cores,
+                                             double intervalSeconds = 0.1) {
+        uint64_t intervalCycles = Cycles::fromSeconds(intervalSeconds);
+        size_t numIntervals = std::max<size_t>(
+            static_cast<size_t>(seconds / intervalSeconds + 0.5), 1);
+        std::vector<std::vector<uint64_t>> counts(cores.size());
+        runOnCores(cores,
+            [&](int thread) {
+                counts[thread].assign(numIntervals, 0);
+            },
+            [&](int thread, uint64_t start) {
+                countOperations([&function, thread] { function(thread); },
+                                start, intervalCycles, numIntervals,
+                                counts[thread].data());
+            });
+        return summarizeThroughput(counts, intervalCycles);
+    }
+
+    AdaptiveResult adaptiveBench(
+        void (*function)(void),
+        const AdaptiveOptions& options = AdaptiveOptions());
+    NoiseResult noiseAwareBench(
+        void (*function)(void), int numIterations,
+        const NoiseOptions& options = NoiseOptions());
+    CounterBenchResult benchWithCounters(
+        void (*function)(void), int numBatches, int batchSize = 1,
+        const std::vector<PerfCounters::Event>& events =
+            PerfCounters::defaultEvents());
+    Statistics measureOverhead(TimerMode mode);
+    Statistics coreToCoreLatency(int coreA, int coreB, int numRoundTrips);
 }
+
+#endif  // PERFUTILS_PERF_H
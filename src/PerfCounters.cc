@@ -0,0 +1,195 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "PerfCounters.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Util.h"
+
+namespace PerfUtils {
+
+/**
+ * How to ask perf_event_open for each Event, in the order of the enum.
+ */
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char* name;
+} EVENT_CONFIGS[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "llc-misses"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch-misses"},
+    {PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+     "dtlb-misses"},
+    {PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+     "l1d-misses"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context-switches"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, "cpu-migrations"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "page-faults"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task-clock"},
+};
+
+/**
+ * Return the hardware events that benchmarks count by default: cycles,
+ * instructions, last-level cache misses, branch misses and data TLB
+ * misses.
+ */
+const std::vector<PerfCounters::Event>&
+PerfCounters::defaultEvents() {
+    static const std::vector<Event> events = {
+        CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, DTLB_MISSES};
+    return events;
+}
+
+/**
+ * Return a short name for an event, in the style of the perf tool.
+ */
+const char*
+PerfCounters::eventName(Event event) {
+    return EVENT_CONFIGS[event].name;
+}
+
+/**
+ * Open a group of counters for the calling thread. Events that cannot be
+ * opened are left out; see getError.
+ *
+ * \param events
+ *      The events to count. The first one that can be opened leads the
+ *      group, so that all of them are scheduled onto the hardware together.
+ */
+PerfCounters::PerfCounters(const std::vector<Event>& events)
+    : counters(),
+      readBuffer(),
+      error() {
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    for (size_t i = 0; i < events.size(); i++) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = EVENT_CONFIGS[events[i]].type;
+        attr.config = EVENT_CONFIGS[events[i]].config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        // Context switches and migrations are counted in the kernel, so
+        // excluding it would leave them at zero.
+        attr.exclude_kernel = events[i] != CONTEXT_SWITCHES &&
+                              events[i] != CPU_MIGRATIONS;
+        attr.exclude_hv = 1;
+        int groupFd = counters.empty() ? -1 : counters[0].fd;
+        int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1,
+                                          groupFd, PERF_FLAG_FD_CLOEXEC));
+        if (fd < 0) {
+            error += Util::format("%s%s: %s", error.empty() ? "" : "; ",
+                                  eventName(events[i]), strerror(errno));
+            continue;
+        }
+        void* page = mmap(NULL, pageSize, PROT_READ, MAP_SHARED, fd, 0);
+        Counter counter = {events[i], fd,
+                           page == MAP_FAILED
+                               ? NULL
+                               : static_cast<perf_event_mmap_page*>(page)};
+        counters.push_back(counter);
+    }
+    readBuffer.resize(counters.size() + 1);
+}
+
+/**
+ * Close the counters.
+ */
+PerfCounters::~PerfCounters() {
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    for (size_t i = counters.size(); i > 0; i--) {
+        if (counters[i - 1].page != NULL)
+            munmap(counters[i - 1].page, pageSize);
+        close(counters[i - 1].fd);
+    }
+}
+
+/**
+ * Return the index of the counter for event, or -1 if it is not open.
+ */
+int
+PerfCounters::indexOf(Event event) const {
+    for (size_t i = 0; i < counters.size(); i++) {
+        if (counters[i].event == event)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+/**
+ * Read the current value of each counter. The values count from when the
+ * object was created, so callers normally subtract two readings.
+ *
+ * \param values
+ *      Receives one value per open counter, in the order of getEvent.
+ *      Values that cannot be read are set to 0.
+ */
+void
+PerfCounters::read(uint64_t* values) {
+    if (counters.empty() || readWithRdpmc(values))
+        return;
+
+    ssize_t bytes = ::read(counters[0].fd, readBuffer.data(),
+                           readBuffer.size() * sizeof(uint64_t));
+    for (size_t i = 0; i < counters.size(); i++) {
+        bool valid = bytes >= static_cast<ssize_t>((i + 2) * sizeof(uint64_t))
+                     && i < readBuffer[0];
+        values[i] = valid ? readBuffer[i + 1] : 0;
+    }
+}
+
+/**
+ * Read every counter with rdpmc through its self-monitoring page, using
+ * the page's sequence lock to get a consistent offset and counter index.
+ *
+ * \return
+ *      False if some counter cannot be read this way (for example, a
+ *      software event, or a kernel that disallows rdpmc), in which case
+ *      values may have been partly filled in.
+ */
+bool
+PerfCounters::readWithRdpmc(uint64_t* values) {
+    for (size_t i = 0; i < counters.size(); i++) {
+        perf_event_mmap_page* page = counters[i].page;
+        if (page == NULL)
+            return false;
+        uint32_t sequence;
+        do {
+            sequence = page->lock;
+            Util::barrier();
+            uint32_t index = page->index;
+            if (!page->cap_user_rdpmc || index == 0)
+                return false;
+            int shift = 64 - page->pmc_width;
+            int64_t count = static_cast<int64_t>(Util::rdpmc(index - 1));
+            count = (count << shift) >> shift;
+            values[i] = page->offset + count;
+            Util::barrier();
+        } while (page->lock != sequence);
+    }
+    return true;
+}
+
+}  // namespace PerfUtils
@@ -0,0 +1,125 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PERFUTILS_PERFCOUNTERS_H
+#define PERFUTILS_PERFCOUNTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <linux/perf_event.h>
+
+#include <string>
+#include <vector>
+
+namespace PerfUtils {
+
+/**
+ * This class programs a group of performance counters for the calling
+ * thread through perf_event_open, and reads them from user space. When the
+ * kernel allows it, each counter is read with rdpmc through its mmap'd
+ * self-monitoring page, which costs tens of cycles instead of a system
+ * call; otherwise the group is read with a single read() call.
+ *
+ * Counters that cannot be opened, because the kernel or hypervisor does
+ * not expose them or perf_event_paranoid forbids them, are left out of the
+ * group, and getError says why. If none can be opened, isAvailable returns
+ * false and read reports nothing; callers can carry on without counters.
+ *
+ * The counters count only the thread that created the object, in user
+ * mode (except for context switches and migrations, which happen in the
+ * kernel), so it must be read from that thread. This class is not
+ * thread-safe.
+ */
+class PerfCounters {
+  public:
+    /**
+     * The events that can be counted.
+     */
+    enum Event {
+        // Hardware events.
+        CYCLES,
+        INSTRUCTIONS,
+        LLC_MISSES,
+        BRANCH_MISSES,
+        DTLB_MISSES,
+        L1D_MISSES,
+
+        // Software events, counted by the kernel; these are available
+        // even without a hardware performance monitoring unit.
+        CONTEXT_SWITCHES,
+        CPU_MIGRATIONS,
+        PAGE_FAULTS,
+        TASK_CLOCK
+    };
+
+    static const std::vector<Event>& defaultEvents();
+    static const char* eventName(Event event);
+
+    explicit PerfCounters(const std::vector<Event>& events = defaultEvents());
+    ~PerfCounters();
+
+    void read(uint64_t* values);
+
+    /// Return true if at least one counter could be opened.
+    bool isAvailable() const { return !counters.empty(); }
+
+    /// Return the number of counters that were opened.
+    size_t getNumCounters() const { return counters.size(); }
+
+    /// Return the event counted by the given counter.
+    Event getEvent(size_t index) const { return counters[index].event; }
+
+    /// Return the index of the counter for event, or -1 if it is not open.
+    int indexOf(Event event) const;
+
+    /// Return a description of the events that could not be opened, or an
+    /// empty string if all of them were.
+    const std::string& getError() const { return error; }
+
+  private:
+    bool readWithRdpmc(uint64_t* values);
+
+    /**
+     * One open counter.
+     */
+    struct Counter {
+        Event event;
+
+        // File descriptor returned by perf_event_open.
+        int fd;
+
+        // The counter's self-monitoring page, or NULL if it could not be
+        // mapped.
+        perf_event_mmap_page* page;
+    };
+
+    // The open counters; the first is the group leader.
+    std::vector<Counter> counters;
+
+    // Space for a group read through read(2): the number of counters
+    // followed by their values. Sized once so that read does not allocate.
+    std::vector<uint64_t> readBuffer;
+
+    // Why some events could not be opened.
+    std::string error;
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+};
+
+}  // namespace PerfUtils
+
+#endif  // PERFUTILS_PERFCOUNTERS_H
@@ -0,0 +1,74 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "PerfCounters.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::PerfCounters;
+
+TEST(PerfCountersTest, eventName) {
+    EXPECT_STREQ("cycles", PerfCounters::eventName(PerfCounters::CYCLES));
+    EXPECT_STREQ("dtlb-misses",
+                 PerfCounters::eventName(PerfCounters::DTLB_MISSES));
+    EXPECT_STREQ("task-clock",
+                 PerfCounters::eventName(PerfCounters::TASK_CLOCK));
+    EXPECT_EQ(5U, PerfCounters::defaultEvents().size());
+}
+
+TEST(PerfCountersTest, degradesCleanly) {
+    // Hardware counters are often missing in virtual machines and
+    // containers; whatever is available, the object must be usable.
+    PerfCounters counters;
+    EXPECT_EQ(counters.isAvailable(), counters.getNumCounters() > 0);
+    if (counters.getNumCounters() < PerfCounters::defaultEvents().size())
+        EXPECT_FALSE(counters.getError().empty());
+    else
+        EXPECT_TRUE(counters.getError().empty());
+
+    std::vector<uint64_t> before(counters.getNumCounters() + 1, 0);
+    std::vector<uint64_t> after(counters.getNumCounters() + 1, 0);
+    counters.read(before.data());
+    counters.read(after.data());
+    for (size_t i = 0; i < counters.getNumCounters(); i++)
+        EXPECT_LE(before[i], after[i]);
+    EXPECT_EQ(-1, counters.indexOf(PerfCounters::TASK_CLOCK));
+}
+
+TEST(PerfCountersTest, softwareEvents) {
+    PerfCounters counters({PerfCounters::TASK_CLOCK,
+                           PerfCounters::PAGE_FAULTS});
+    if (!counters.isAvailable())
+        return;
+    ASSERT_EQ(2U, counters.getNumCounters());
+    EXPECT_EQ(PerfCounters::PAGE_FAULTS, counters.getEvent(1));
+    EXPECT_EQ(1, counters.indexOf(PerfCounters::PAGE_FAULTS));
+
+    uint64_t before[2];
+    uint64_t after[2];
+    counters.read(before);
+    const size_t size = 64 << 20;
+    char* memory = new char[size];
+    memset(memory, 1, size);
+    counters.read(after);
+    delete[] memory;
+    EXPECT_LT(before[0], after[0]);
+    EXPECT_LT(before[1] + 100, after[1]);
+}
@@ -16,10 +16,17 @@
 #include "Perf.h"
 
 #include <fcntl.h>
+#include <math.h>
+#include <sched.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -35,6 +42,14 @@ void fixedPerformance(uint64_t* N) {
     *N = 7;
 }
 
+/**
+ * Reports 7 most of the time, and a stall of 1000 every 100th call.
+ */
+void occasionalStall(uint64_t* N) {
+    static int calls = 0;
+    *N = (++calls % 100 == 0) ? 1000 : 7;
+}
+
 TEST(PerfTest, bench) {
     Statistics stats = PerfUtils::bench([]() {fixedCycles(500);}, 100000);
     EXPECT_EQ(100000, stats.count);
@@ -50,3 +65,391 @@ TEST(PerfTest, manualBench) {
     EXPECT_EQ(7, stats.max);
     EXPECT_EQ(0, stats.stddev);
 }
+
+TEST(PerfTest, benchCorrected) {
+    PerfUtils::BenchResult result = PerfUtils::bench(
+        []() {fixedCycles(500);}, 100000, PerfUtils::TIMER_SERIALIZED);
+    EXPECT_EQ(100000, result.raw.count);
+    EXPECT_EQ(100000, result.corrected.count);
+    EXPECT_LT(0, result.overhead.count);
+    EXPECT_LE(result.corrected.median, result.raw.median);
+    EXPECT_LE(result.corrected.min, result.raw.min);
+    EXPECT_EQ(result.raw.median - result.overhead.median,
+              result.corrected.median);
+}
+
+TEST(PerfTest, measureOverhead) {
+    Statistics rdtsc = PerfUtils::measureOverhead(PerfUtils::TIMER_RDTSC);
+    Statistics serialized =
+        PerfUtils::measureOverhead(PerfUtils::TIMER_SERIALIZED);
+    EXPECT_LT(0, rdtsc.count);
+    EXPECT_LT(0, serialized.count);
+    EXPECT_LE(rdtsc.min, rdtsc.median);
+
+    // The calibration is cached, so repeated calls agree.
+    EXPECT_EQ(rdtsc.median,
+              PerfUtils::measureOverhead(PerfUtils::TIMER_RDTSC).median);
+}
+
+TEST(PerfTest, benchHistogram) {
+    PerfUtils::Histogram histogram;
+    Statistics stats = PerfUtils::bench([]() {fixedCycles(500);}, 100000,
+                                        &histogram);
+    EXPECT_EQ(100000, stats.count);
+    EXPECT_EQ(100000, histogram.getCount());
+    EXPECT_LE(20, stats.min);
+}
+
+TEST(PerfTest, manualBenchHistogram) {
+    PerfUtils::Histogram histogram;
+    Statistics stats =
+        PerfUtils::manualBench(fixedPerformance, 100000, &histogram);
+    EXPECT_EQ(100000, stats.count);
+    EXPECT_EQ(7, stats.average);
+    EXPECT_EQ(7, stats.median);
+    EXPECT_EQ(7, stats.min);
+    EXPECT_EQ(7, stats.max);
+    EXPECT_EQ(0, stats.stddev);
+}
+
+TEST(PerfTest, manualBenchWithInterval) {
+    PerfUtils::IntervalResult result =
+        PerfUtils::manualBenchWithInterval(occasionalStall, 1000, 10);
+    EXPECT_EQ(1000, result.raw.count);
+    EXPECT_EQ(7, result.raw.P90);
+    EXPECT_EQ(1000, result.raw.max);
+
+    // Each stall hides 99 requests, which waited 990, 980, ... 10.
+    EXPECT_EQ(1000 + 10 * 99, result.corrected.count);
+    EXPECT_EQ(7, result.corrected.P40);
+    EXPECT_LT(400, result.corrected.P90);
+    EXPECT_EQ(1000, result.corrected.max);
+}
+
+TEST(PerfTest, benchWithInterval) {
+    PerfUtils::IntervalResult result = PerfUtils::benchWithInterval(
+        []() {fixedCycles(500);}, 10000, 1000000000);
+    EXPECT_EQ(10000, result.raw.count);
+    EXPECT_EQ(10000, result.corrected.count);
+}
+
+TEST(PerfTest, streamingBench) {
+    PerfUtils::StreamingResult result = PerfUtils::streamingBench(
+        []() {fixedCycles(500);}, 10000, 100);
+    EXPECT_EQ(10000, result.stats.count);
+    EXPECT_EQ(10000, result.histogram.getCount());
+    EXPECT_EQ(10000, result.moments.getCount());
+    EXPECT_LE(20, result.stats.min);
+    EXPECT_EQ(100, result.reservoir.size());
+}
+
+TEST(PerfTest, streamingManualBench) {
+    // Several blocks, the last one partial; the counter in occasionalStall
+    // may start anywhere, but any 10^6 calls hold 10^4 stalls.
+    PerfUtils::StreamingResult result =
+        PerfUtils::streamingManualBench(occasionalStall, 1000000, 1000);
+    EXPECT_EQ(1000000, result.stats.count);
+    EXPECT_DOUBLE_EQ(16.93, result.moments.getMean());
+    EXPECT_EQ(16, result.stats.average);
+    EXPECT_EQ(7, result.stats.median);
+    EXPECT_EQ(1000, result.stats.P99);
+    EXPECT_EQ(1000, result.stats.max);
+    ASSERT_EQ(1000, result.reservoir.size());
+    for (uint64_t value : result.reservoir)
+        EXPECT_TRUE(value == 7 || value == 1000);
+
+    result = PerfUtils::streamingManualBench(fixedPerformance, 0);
+    EXPECT_EQ(0, result.stats.count);
+    EXPECT_TRUE(result.reservoir.empty());
+}
+
+TEST(PerfTest, adaptiveBench) {
+    PerfUtils::AdaptiveOptions options;
+    options.quantile = 0.5;
+    options.tolerance = 0.2;
+    options.timeBudget = 10;
+    PerfUtils::AdaptiveResult result =
+        PerfUtils::adaptiveBench([]() {fixedCycles(500);}, options);
+    EXPECT_TRUE(result.converged);
+    EXPECT_LE(1, result.warmupRounds);
+    EXPECT_EQ(result.warmupRounds * 1000U, result.warmupIterations);
+    EXPECT_EQ(result.numIterations, result.stats.count);
+    EXPECT_LE(result.lower, result.quantileValue);
+    EXPECT_GE(result.upper, result.quantileValue);
+    EXPECT_LE(static_cast<double>(result.upper - result.lower) / 2,
+              0.2 * static_cast<double>(result.quantileValue));
+}
+
+TEST(PerfTest, adaptiveBenchLimits) {
+    PerfUtils::AdaptiveOptions options;
+    options.tolerance = 0;
+    options.maxWarmupRounds = 2;
+    options.maxIterations = 5000;
+    PerfUtils::AdaptiveResult result =
+        PerfUtils::adaptiveBench([]() {fixedCycles(500);}, options);
+    EXPECT_LE(result.warmupRounds, 2);
+
+    // Only perfectly repeatable timings can meet a zero tolerance.
+    if (result.quantileValue != result.lower ||
+        result.quantileValue != result.upper) {
+        EXPECT_FALSE(result.converged);
+        EXPECT_EQ(5000U, result.numIterations);
+    }
+    EXPECT_EQ(result.numIterations, result.stats.count);
+    EXPECT_LE(result.lower, result.quantileValue);
+    EXPECT_GE(result.upper, result.quantileValue);
+}
+
+TEST(PerfTest, adaptiveBenchNoIterations) {
+    PerfUtils::AdaptiveOptions options;
+    options.maxIterations = 0;
+    EXPECT_DEATH(PerfUtils::adaptiveBench([]() {}, options),
+                 "maxIterations must be positive");
+}
+
+TEST(PerfTest, benchCallable) {
+    int calls = 0;
+    uint64_t sum = 0;
+    Statistics stats = PerfUtils::bench([&calls, &sum]() {
+        calls++;
+        for (uint64_t i = 0; i < 100; i++)
+            sum += i;
+        PerfUtils::doNotOptimize(sum);
+    }, 10000);
+    EXPECT_EQ(10000, stats.count);
+    EXPECT_EQ(10000, calls);
+    EXPECT_EQ(10000U * 4950, sum);
+}
+
+TEST(PerfTest, doNotOptimize) {
+    const int constant = 3;
+    PerfUtils::doNotOptimize(constant);
+    double value = 1.5;
+    PerfUtils::doNotOptimize(value);
+    uint64_t buffer[4] = {1, 2, 3, 4};
+    PerfUtils::doNotOptimize(buffer);
+    PerfUtils::clobberMemory();
+    EXPECT_EQ(1.5, value);
+    EXPECT_EQ(4U, buffer[3]);
+}
+
+void incrementCounter() {
+    static volatile uint64_t counter = 0;
+    counter = counter + 1;
+}
+
+TEST(PerfTest, batchedBench) {
+    uint64_t value = 1;
+    PerfUtils::BatchedResult result = PerfUtils::batchedBench([&value]() {
+        value = value * 3 + 1;
+        PerfUtils::doNotOptimize(value);
+    }, 1000);
+    EXPECT_EQ(1000, result.perCall.count);
+    EXPECT_LT(1, result.batchSize);
+    EXPECT_LT(0, result.average);
+    EXPECT_GT(1000, result.average);
+    EXPECT_GE(result.callStddev,
+              static_cast<double>(result.perCall.stddev));
+}
+
+TEST(PerfTest, batchedBenchFunctionPointer) {
+    PerfUtils::BatchedResult result =
+        PerfUtils::batchedBench(incrementCounter, 100, 100000);
+    EXPECT_EQ(100, result.perCall.count);
+    EXPECT_LE(1024, result.batchSize);
+    EXPECT_NEAR(result.average, result.perCall.average, 1);
+}
+
+TEST(PerfTest, summarizeBatches) {
+    uint64_t overhead = PerfUtils::measureOverhead(PerfUtils::TIMER_RDTSC)
+                            .median;
+    uint64_t blocks[] = {overhead + 400, overhead + 400, overhead + 404,
+                         overhead + 396};
+    PerfUtils::BatchedResult result =
+        PerfUtils::summarizeBatches(blocks, 4, 4);
+    EXPECT_EQ(4, result.batchSize);
+    EXPECT_EQ(100, result.perCall.median);
+    EXPECT_EQ(99, result.perCall.min);
+    EXPECT_EQ(101, result.perCall.max);
+    EXPECT_DOUBLE_EQ(100, result.average);
+
+    // The block means spread by less than a cycle, which perCall.stddev
+    // rounds away: the block times have a stddev of sqrt(8), so the means
+    // have sqrt(8) / 4, and single calls sqrt(8) / 4 * sqrt(4).
+    EXPECT_EQ(0, result.perCall.stddev);
+    EXPECT_NEAR(sqrt(2.0), result.callStddev, 1e-9);
+}
+
+TEST(PerfTest, parallelBench) {
+    std::atomic<uint64_t> calls[2];
+    calls[0] = 0;
+    calls[1] = 0;
+    std::vector<int> cores = {-1, -1};
+    PerfUtils::ParallelResult result = PerfUtils::parallelBench(
+        [&calls](int thread) {
+            calls[thread]++;
+            fixedCycles(100);
+        },
+        1000, cores);
+    ASSERT_EQ(2U, result.perThread.size());
+    EXPECT_EQ(1000, result.perThread[0].count);
+    EXPECT_EQ(1000, result.perThread[1].count);
+    EXPECT_EQ(1000U, calls[0].load());
+    EXPECT_EQ(1000U, calls[1].load());
+    EXPECT_EQ(2000, result.merged.count);
+    EXPECT_EQ(std::min(result.perThread[0].min, result.perThread[1].min),
+              result.merged.min);
+    EXPECT_EQ(std::max(result.perThread[0].max, result.perThread[1].max),
+              result.merged.max);
+    EXPECT_LT(0U, result.elapsedCycles);
+    EXPECT_LT(0, result.throughput);
+}
+
+TEST(PerfTest, parallelBenchPinned) {
+    PerfUtils::ParallelResult result =
+        PerfUtils::parallelBench([](int) { fixedCycles(100); }, 1000, 3);
+    ASSERT_EQ(3U, result.perThread.size());
+    EXPECT_EQ(3000, result.merged.count);
+    EXPECT_EQ(3U, PerfUtils::spreadOverCores(3).size());
+    EXPECT_LE(0, PerfUtils::spreadOverCores(1)[0]);
+}
+
+TEST(PerfTest, coreToCoreLatency) {
+    Statistics stats = PerfUtils::coreToCoreLatency(-1, -1, 20);
+    EXPECT_EQ(20, stats.count);
+    EXPECT_LT(0, stats.min);
+    EXPECT_LE(stats.median, stats.P99);
+}
+
+/**
+ * Blocks in the kernel on every 1000th call, which is a voluntary context
+ * switch. A short sleep can expire before the thread blocks, for example
+ * when a virtual CPU is descheduled by its host, so sleep for a
+ * millisecond.
+ */
+void occasionalSleep() {
+    static int calls = 0;
+    if (++calls % 1000 == 0)
+        usleep(1000);
+}
+
+TEST(PerfTest, noiseAwareBench) {
+    PerfUtils::NoiseOptions options;
+    options.useCounters = true;
+    PerfUtils::NoiseResult result =
+        PerfUtils::noiseAwareBench(occasionalSleep, 10000, options);
+    EXPECT_EQ(10000, result.stats.count);
+    EXPECT_EQ(10000, result.clean.count + result.suspect.count);
+    EXPECT_EQ(10, result.numBatches);
+    EXPECT_LE(10, result.voluntarySwitches);
+    if (result.counterError.empty()) {
+        EXPECT_LE(10, result.counterSwitches);
+    }
+
+    // The sleeps block on their own, so they are real slow calls and stay
+    // among the clean samples.
+    EXPECT_LT(PerfUtils::Cycles::fromMicroseconds(500), result.clean.max);
+    EXPECT_GE(result.involuntarySwitches + result.coreChanges +
+              result.counterMigrations + result.counterSwitches,
+              static_cast<uint64_t>(result.suspect.count));
+
+    options.exclude = true;
+    options.batchSize = 5000;
+    result = PerfUtils::noiseAwareBench(occasionalSleep, 10000, options);
+    EXPECT_EQ(2, result.numBatches);
+    EXPECT_EQ(result.clean.count, result.stats.count);
+    EXPECT_EQ(result.clean.max, result.stats.max);
+    EXPECT_LT(PerfUtils::Cycles::fromMicroseconds(500), result.stats.max);
+}
+
+TEST(PerfTest, rdtscpAux) {
+    cpu_set_t saved = PerfUtils::Util::getCpuAffinity();
+    int core = sched_getcpu();
+    PerfUtils::Util::pinThreadToCore(core);
+    uint32_t aux;
+    EXPECT_LT(0U, PerfUtils::Cycles::rdtscp(&aux));
+    EXPECT_EQ(static_cast<uint32_t>(core), aux & 0xfff);
+    PerfUtils::Util::setCpuAffinity(saved);
+}
+
+TEST(PerfTest, benchWithCounters) {
+    PerfUtils::CounterBenchResult result = PerfUtils::benchWithCounters(
+        []() {fixedCycles(500);}, 100, 10);
+    EXPECT_EQ(100, result.time.count);
+    EXPECT_LE(20, result.time.min);
+    if (result.counters.size() < PerfUtils::PerfCounters::defaultEvents()
+                                     .size()) {
+        EXPECT_FALSE(result.counterError.empty());
+    }
+    for (size_t i = 0; i < result.counters.size(); i++)
+        EXPECT_EQ(100, result.counters[i].perIteration.count);
+    if (result.ipc == 0)
+        return;
+    // 500 iterations of a nop loop take at least 1000 instructions.
+    EXPECT_LT(1000, result.counters[1].average);
+}
+
+TEST(PerfTest, benchWithSoftwareCounters) {
+    PerfUtils::CounterBenchResult result = PerfUtils::benchWithCounters(
+        []() {usleep(100);}, 100, 1,
+        {PerfUtils::PerfCounters::CONTEXT_SWITCHES});
+    EXPECT_EQ(100, result.time.count);
+    EXPECT_EQ(0, result.ipc);
+    ASSERT_GE(1U, result.counters.size());
+
+    // Each sleep blocks, which is a context switch.
+    if (result.counters.size() == 1) {
+        EXPECT_LE(1U, result.counters[0].perIteration.median);
+        EXPECT_LE(1.0, result.counters[0].average);
+    }
+}
+
+TEST(PerfTest, summarizeThroughput) {
+    uint64_t intervalCycles = PerfUtils::Cycles::fromSeconds(0.5);
+    std::vector<std::vector<uint64_t>> counts = {{10, 20, 30}, {0, 20, 0}};
+    PerfUtils::ThroughputResult result =
+        PerfUtils::summarizeThroughput(counts, intervalCycles);
+    ASSERT_EQ(3U, result.series.size());
+    EXPECT_NEAR(20, result.series[0], 1e-6);
+    EXPECT_NEAR(80, result.series[1], 1e-6);
+    EXPECT_NEAR(60, result.series[2], 1e-6);
+    EXPECT_NEAR(160.0 / 3, result.mean, 1e-6);
+    EXPECT_NEAR(((20 - 160.0 / 3) * (20 - 160.0 / 3) +
+                 (80 - 160.0 / 3) * (80 - 160.0 / 3) +
+                 (60 - 160.0 / 3) * (60 - 160.0 / 3)) / 3,
+                result.variance, 1e-6);
+    EXPECT_NEAR(20, result.min, 1e-6);
+    EXPECT_NEAR(80, result.max, 1e-6);
+    EXPECT_EQ(80U, result.operations);
+    EXPECT_THAT(result.perThread, testing::ElementsAre(60, 20));
+}
+
+TEST(PerfTest, throughputBench) {
+    uint64_t calls = 0;
+    PerfUtils::ThroughputResult result = PerfUtils::throughputBench(
+        [&calls]() {
+            calls++;
+            fixedCycles(100);
+        },
+        0.2, 0.05);
+    ASSERT_EQ(4U, result.series.size());
+    EXPECT_LE(result.operations, calls);
+    EXPECT_LT(0U, result.operations);
+    EXPECT_LE(result.min, result.mean);
+    EXPECT_GE(result.max, result.mean);
+}
+
+TEST(PerfTest, parallelThroughputBench) {
+    std::atomic<uint64_t> calls(0);
+    PerfUtils::ThroughputResult result = PerfUtils::parallelThroughputBench(
+        [&calls](int) {
+            calls++;
+            fixedCycles(100);
+        },
+        0.2, {-1, -1}, 0.1);
+    ASSERT_EQ(2U, result.series.size());
+    ASSERT_EQ(2U, result.perThread.size());
+    EXPECT_EQ(result.perThread[0] + result.perThread[1], result.operations);
+    EXPECT_LE(result.operations, calls.load());
+    EXPECT_LT(0U, result.operations);
+}
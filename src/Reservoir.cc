@@ -0,0 +1,86 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Reservoir.h"
+
+#include <math.h>
+
+namespace PerfUtils {
+
+/**
+ * Construct an empty Reservoir.
+ *
+ * \param capacity
+ *      Number of values to keep. With a capacity of 0, nothing is kept.
+ * \param seed
+ *      Seed for the random choices, so that samples are reproducible.
+ */
+Reservoir::Reservoir(size_t capacity, uint64_t seed)
+    : capacity(capacity),
+      count(0),
+      nextIndex(capacity == 0 ? UINT64_MAX : 0),
+      threshold(1.0),
+      samples(),
+      generator(seed) {
+    samples.reserve(capacity);
+}
+
+/**
+ * Offer several values to the sample; the result is the same as recording
+ * them one at a time, but values that will be skipped are not examined.
+ */
+void
+Reservoir::record(const uint64_t* values, size_t count) {
+    uint64_t end = this->count + count;
+    while (nextIndex < end) {
+        uint64_t index = nextIndex;
+        this->count = index;
+        replace(values[index - (end - count)]);
+    }
+    this->count = end;
+}
+
+/**
+ * Return a random number in (0, 1].
+ */
+double
+Reservoir::random() {
+    return 1.0 - std::generate_canonical<double, 53>(generator);
+}
+
+/**
+ * Put the value at index count of the stream into the sample, and choose
+ * the index of the next value that will be.
+ */
+void
+Reservoir::replace(uint64_t value) {
+    double k = static_cast<double>(capacity);
+    if (samples.size() < capacity) {
+        samples.push_back(value);
+        if (samples.size() < capacity) {
+            nextIndex = count + 1;
+            return;
+        }
+    } else {
+        samples[generator() % capacity] = value;
+    }
+    threshold *= exp(log(random()) / k);
+    double skip = floor(log(random()) / log1p(-threshold));
+    nextIndex = skip < static_cast<double>(UINT64_MAX - count)
+                    ? count + 1 + static_cast<uint64_t>(skip)
+                    : UINT64_MAX;
+}
+
+}  // namespace PerfUtils
@@ -0,0 +1,89 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PERFUTILS_RESERVOIR_H
+#define PERFUTILS_RESERVOIR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <random>
+#include <vector>
+
+namespace PerfUtils {
+
+/**
+ * This class keeps a uniform random sample of fixed size from a stream of
+ * values of unknown length: after any number of values have been
+ * recorded, each of them is in the sample with the same probability. It
+ * lets a run of billions of iterations keep some raw values for detailed
+ * analysis (for example with compare or printStatistics) in bounded memory.
+ *
+ * It uses Li's Algorithm L, which computes how many values to skip before
+ * the next replacement instead of drawing a random number for every
+ * value, so recording costs a comparison in the common case.
+ *
+ * This class is not thread-safe.
+ */
+class Reservoir {
+  public:
+    explicit Reservoir(size_t capacity, uint64_t seed = 1);
+
+    /**
+     * Offer one value to the sample.
+     */
+    inline void record(uint64_t value) {
+        if (count == nextIndex)
+            replace(value);
+        count++;
+    }
+
+    void record(const uint64_t* values, size_t count);
+
+    /// Return the values in the sample, in no particular order.
+    const std::vector<uint64_t>& getSamples() const { return samples; }
+
+    /// Return the number of values offered so far.
+    uint64_t getCount() const { return count; }
+
+    /// Return the largest number of values kept.
+    size_t getCapacity() const { return capacity; }
+
+  private:
+    void replace(uint64_t value);
+    double random();
+
+    // Largest number of values kept.
+    size_t capacity;
+
+    // Number of values offered so far.
+    uint64_t count;
+
+    // Index in the stream of the next value that goes into the sample.
+    uint64_t nextIndex;
+
+    // Algorithm L's running threshold: the largest of the random keys of
+    // the values currently in the sample.
+    double threshold;
+
+    // The sample.
+    std::vector<uint64_t> samples;
+
+    std::mt19937_64 generator;
+};
+
+}  // namespace PerfUtils
+
+#endif  // PERFUTILS_RESERVOIR_H
@@ -0,0 +1,70 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Reservoir.h"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::Reservoir;
+
+TEST(ReservoirTest, keepsEverythingUntilFull) {
+    Reservoir reservoir(10);
+    for (uint64_t i = 0; i < 5; i++)
+        reservoir.record(i);
+    EXPECT_EQ(5, reservoir.getCount());
+    EXPECT_THAT(reservoir.getSamples(), testing::ElementsAre(0, 1, 2, 3, 4));
+
+    Reservoir empty(0);
+    empty.record(1);
+    EXPECT_EQ(1, empty.getCount());
+    EXPECT_TRUE(empty.getSamples().empty());
+}
+
+TEST(ReservoirTest, uniformSample) {
+    const uint64_t numValues = 1000000;
+    Reservoir reservoir(10000);
+    for (uint64_t i = 0; i < numValues; i++)
+        reservoir.record(i);
+    EXPECT_EQ(numValues, reservoir.getCount());
+    ASSERT_EQ(10000, reservoir.getSamples().size());
+
+    // Each tenth of the input should hold about a tenth of the sample.
+    std::vector<int> deciles(10);
+    for (uint64_t value : reservoir.getSamples())
+        deciles[value * 10 / numValues]++;
+    for (int count : deciles) {
+        EXPECT_LT(850, count);
+        EXPECT_GT(1150, count);
+    }
+}
+
+TEST(ReservoirTest, recordArrayMatchesSingleValues) {
+    std::vector<uint64_t> values(100000);
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = i * 3;
+    Reservoir single(100, 7);
+    for (uint64_t value : values)
+        single.record(value);
+    Reservoir blocks(100, 7);
+    for (size_t i = 0; i < values.size(); i += 4096) {
+        size_t count = values.size() - i < 4096 ? values.size() - i : 4096;
+        blocks.record(values.data() + i, count);
+    }
+    EXPECT_EQ(single.getCount(), blocks.getCount());
+    EXPECT_EQ(single.getSamples(), blocks.getSamples());
+}
@@ -0,0 +1,181 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "SampleFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Util.h"
+#include "mkdir.h"
+
+namespace PerfUtils {
+
+static const char MAGIC[8] = {'P', 'U', 'S', 'A', 'M', 'P', 'L', 'E'};
+static const uint32_t VERSION = 1;
+
+/**
+ * The fixed part of a sample file; see the comment on SampleFile.
+ */
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t dataOffset;
+    uint64_t count;
+    double cyclesPerSecond;
+    char unit[16];
+    uint32_t labelLength;
+    uint32_t reserved;
+};
+
+/**
+ * Write all of a buffer to a file descriptor, in as few system calls as
+ * the kernel allows.
+ */
+static void
+writeAll(int fd, const void* buffer, size_t length, const char* path) {
+    const char* next = static_cast<const char*>(buffer);
+    while (length > 0) {
+        // Linux transfers at most about 2GB per call.
+        size_t chunk = length < (1UL << 30) ? length : (1UL << 30);
+        ssize_t written = ::write(fd, next, chunk);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            PERFUTILS_DIE("SampleFile couldn't write %s: %s", path,
+                          strerror(errno));
+        }
+        next += written;
+        length -= written;
+    }
+}
+
+/**
+ * Map a sample file into memory.
+ *
+ * \param path
+ *      Name of a file written by SampleFile::write.
+ */
+SampleFile::SampleFile(const char* path)
+    : mapping(NULL),
+      mappingSize(0),
+      samples(NULL),
+      count(0),
+      label(),
+      unit(),
+      cyclesPerSecond(0) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        PERFUTILS_DIE("SampleFile couldn't open %s: %s", path,
+                      strerror(errno));
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0)
+        PERFUTILS_DIE("SampleFile couldn't stat %s: %s", path,
+                      strerror(errno));
+    mappingSize = fileStat.st_size;
+    if (mappingSize < sizeof(Header))
+        PERFUTILS_DIE("SampleFile: %s is too short to be a sample file",
+                      path);
+    mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                   fd, 0);
+    if (mapping == MAP_FAILED)
+        PERFUTILS_DIE("SampleFile couldn't map %s: %s", path,
+                      strerror(errno));
+    close(fd);
+
+    const Header* header = static_cast<const Header*>(mapping);
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0)
+        PERFUTILS_DIE("SampleFile: %s is not a sample file", path);
+    if (header->version != VERSION)
+        PERFUTILS_DIE("SampleFile: %s has unsupported version %u", path,
+                      header->version);
+    if (sizeof(Header) + header->labelLength > header->dataOffset ||
+        header->dataOffset % sizeof(uint64_t) != 0 ||
+        header->dataOffset > mappingSize ||
+        header->count > (mappingSize - header->dataOffset) / sizeof(uint64_t))
+        PERFUTILS_DIE("SampleFile: %s is truncated or corrupt", path);
+
+    count = header->count;
+    cyclesPerSecond = header->cyclesPerSecond;
+    unit.assign(header->unit, strnlen(header->unit, sizeof(header->unit)));
+    label.assign(static_cast<const char*>(mapping) + sizeof(Header),
+                 header->labelLength);
+    samples = reinterpret_cast<uint64_t*>(static_cast<char*>(mapping) +
+                                          header->dataOffset);
+}
+
+SampleFile::~SampleFile() {
+    munmap(mapping, mappingSize);
+}
+
+/**
+ * Write raw samples to a file in binary form, creating any missing parent
+ * directories. The header and the samples are each written with a single
+ * large write, so this runs at the speed of the disk.
+ *
+ * \param path
+ *      Name of the file to write; any existing file is replaced.
+ * \param label
+ *      Name of the benchmark the samples came from.
+ * \param unit
+ *      Unit of the samples, such as "cycles"; at most 15 characters are
+ *      kept.
+ * \param cyclesPerSecond
+ *      Cycle counter frequency of this machine, so that samples in cycles
+ *      can be converted to time later; 0 if not applicable.
+ * \param rawdata
+ *      The samples to write.
+ * \param count
+ *      Number of samples in rawdata.
+ */
+void
+SampleFile::write(const char* path, const char* label, const char* unit,
+                  double cyclesPerSecond, const uint64_t* rawdata,
+                  size_t count) {
+    size_t labelLength = strlen(label);
+    size_t dataOffset = sizeof(Header) + labelLength;
+    dataOffset = (dataOffset + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+
+    // Build the header, label and padding in one buffer.
+    std::string prefix(dataOffset, '\0');
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.dataOffset = static_cast<uint32_t>(dataOffset);
+    header.count = count;
+    header.cyclesPerSecond = cyclesPerSecond;
+    strncpy(header.unit, unit, sizeof(header.unit) - 1);
+    header.labelLength = static_cast<uint32_t>(labelLength);
+    memcpy(&prefix[0], &header, sizeof(header));
+    memcpy(&prefix[sizeof(header)], label, labelLength);
+
+    ensureParents(path);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        PERFUTILS_DIE("SampleFile couldn't create %s: %s", path,
+                      strerror(errno));
+    writeAll(fd, prefix.data(), prefix.size(), path);
+    writeAll(fd, rawdata, count * sizeof(uint64_t), path);
+    if (close(fd) != 0)
+        PERFUTILS_DIE("SampleFile couldn't write %s: %s", path,
+                      strerror(errno));
+}
+
+}  // namespace PerfUtils
@@ -0,0 +1,102 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PERFUTILS_SAMPLEFILE_H
+#define PERFUTILS_SAMPLEFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "Stats.h"
+
+namespace PerfUtils {
+
+/**
+ * This class provides access to a file of raw samples written by
+ * SampleFile::write (or by printStatistics with BINARY_SAMPLES). The file is
+ * mapped into memory rather than read, so the samples can be handed to
+ * computeStatistics and friends without copying them.
+ *
+ * The file starts with a fixed header, followed by the label, followed by
+ * the samples as an array of native-endian uint64_t starting at an 8-byte
+ * aligned offset:
+ *
+ *     magic            8 bytes, "PUSAMPLE"
+ *     version          uint32_t, currently 1
+ *     dataOffset       uint32_t, offset of the first sample
+ *     count            uint64_t, number of samples
+ *     cyclesPerSecond  double, for converting cycles to time; 0 if unknown
+ *     unit             16 bytes, NUL-padded, e.g. "cycles" or "ns"
+ *     labelLength      uint32_t
+ *     reserved         uint32_t
+ *     label            labelLength bytes
+ *
+ * The mapping is private and writable: computeStatistics may reorder the
+ * samples in memory, but the file itself is never modified.
+ */
+class SampleFile {
+  public:
+    explicit SampleFile(const char* path);
+    ~SampleFile();
+
+    static void write(const char* path, const char* label, const char* unit,
+                      double cyclesPerSecond, const uint64_t* rawdata,
+                      size_t count);
+
+    /// Return the samples in the file.
+    uint64_t* getSamples() { return samples; }
+
+    /// Return the number of samples in the file.
+    size_t getCount() const { return count; }
+
+    /// Return the label the samples were recorded under.
+    const std::string& getLabel() const { return label; }
+
+    /// Return the unit of the samples, such as "cycles".
+    const std::string& getUnit() const { return unit; }
+
+    /// Return the cycle counter frequency of the machine that recorded the
+    /// samples, or 0 if it was not recorded.
+    double getCyclesPerSecond() const { return cyclesPerSecond; }
+
+    /**
+     * Compute summary statistics over the samples in place.
+     */
+    Statistics computeStatistics() {
+        return ::computeStatistics(samples, count);
+    }
+
+  private:
+    SampleFile(const SampleFile&) = delete;
+    SampleFile& operator=(const SampleFile&) = delete;
+
+    // Start and length of the mapping of the whole file.
+    void* mapping;
+    size_t mappingSize;
+
+    // Points into the mapping at the first sample.
+    uint64_t* samples;
+    size_t count;
+
+    std::string label;
+    std::string unit;
+    double cyclesPerSecond;
+};
+
+}  // namespace PerfUtils
+
+#endif  // PERFUTILS_SAMPLEFILE_H
@@ -0,0 +1,121 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "SampleFile.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::SampleFile;
+
+TEST(SampleFileTest, writeAndMap) {
+    char dir[] = "/tmp/SampleFileTest_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    std::string path = std::string(dir) + "/nested/samples";
+
+    std::vector<uint64_t> input;
+    for (uint64_t i = 0; i < 10000; i++)
+        input.push_back((i * 7919) % 10000);
+    SampleFile::write(path.c_str(), "odd label", "ns", 2.5e9, input.data(),
+                      input.size());
+
+    {
+        SampleFile file(path.c_str());
+        EXPECT_EQ("odd label", file.getLabel());
+        EXPECT_EQ("ns", file.getUnit());
+        EXPECT_EQ(2.5e9, file.getCyclesPerSecond());
+        ASSERT_EQ(input.size(), file.getCount());
+        EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(file.getSamples()) % 8);
+        for (size_t i = 0; i < input.size(); i++)
+            ASSERT_EQ(input[i], file.getSamples()[i]);
+
+        std::vector<uint64_t> copy = input;
+        Statistics expected = computeStatistics(copy.data(), copy.size());
+        Statistics stats = file.computeStatistics();
+        EXPECT_EQ(expected.average, stats.average);
+        EXPECT_EQ(expected.median, stats.median);
+        EXPECT_EQ(expected.P99, stats.P99);
+    }
+
+    // Reordering the mapped samples must not change the file.
+    SampleFile again(path.c_str());
+    for (size_t i = 0; i < input.size(); i++)
+        ASSERT_EQ(input[i], again.getSamples()[i]);
+
+    unlink(path.c_str());
+    rmdir((std::string(dir) + "/nested").c_str());
+    rmdir(dir);
+}
+
+TEST(SampleFileTest, printStatisticsBinary) {
+    char dir[] = "/tmp/SampleFileTest_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    uint64_t input[] = {5, 1, 4, 2, 3};
+    testing::internal::CaptureStdout();
+    printStatistics("binaryDump", input, 5, dir, BINARY_SAMPLES);
+    testing::internal::GetCapturedStdout();
+
+    std::string path = std::string(dir) + "/binaryDump";
+    {
+        SampleFile file(path.c_str());
+        EXPECT_EQ("binaryDump", file.getLabel());
+        EXPECT_EQ("cycles", file.getUnit());
+        ASSERT_EQ(5U, file.getCount());
+        EXPECT_EQ(3U, file.computeStatistics().median);
+    }
+    unlink(path.c_str());
+    rmdir(dir);
+}
+
+TEST(SampleFileTest, empty) {
+    char path[] = "/tmp/SampleFileTest_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    SampleFile::write(path, "", "cycles", 0, NULL, 0);
+    SampleFile file(path);
+    EXPECT_EQ(0U, file.getCount());
+    EXPECT_EQ("", file.getLabel());
+    unlink(path);
+}
+
+TEST(SampleFileTest, corruptCount) {
+    char path[] = "/tmp/SampleFileTest_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    uint64_t input[] = {1, 2, 3};
+    SampleFile::write(path, "x", "cycles", 0, input, 3);
+
+    // A count whose size in bytes wraps around to 0 must not pass for a
+    // file that holds it. The count follows the magic number, the version
+    // and the data offset in the header.
+    uint64_t count = 1UL << 61;
+    fd = open(path, O_WRONLY);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(count)),
+              pwrite(fd, &count, sizeof(count), 16));
+    close(fd);
+    EXPECT_DEATH(SampleFile file(path), "truncated or corrupt");
+    unlink(path);
+}
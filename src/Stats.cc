@@ -19,53 +19,354 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "Cycles.h"
+#include "Moments.h"
+#include "SampleFile.h"
+#include "Util.h"
 #include "mkdir.h"
 
-int
-compare(const void* a, const void* b) {
-    if (*(const uint64_t*)a == *(const uint64_t*)b)
-        return 0;
-    return *(const uint64_t*)a < *(const uint64_t*)b ? -1 : 1;
+/**
+ * Rearrange [begin, end) so that, for every rank in ranks, the element at
+ * that rank is the one that would be there if the range were sorted, every
+ * element before it is no larger, and every element after it is no smaller.
+ * This costs O(n log k) for k ranks, instead of the O(n log n) needed to
+ * sort the whole range, and needs no extra memory.
+ *
+ * \param begin
+ *      First element of the range to partition.
+ * \param end
+ *      One past the last element of the range to partition.
+ * \param ranks
+ *      Distinct ranks to select, in increasing order, relative to
+ *      begin - offset.
+ * \param numRanks
+ *      Number of entries in ranks.
+ * \param offset
+ *      Rank of the element at begin within the original array.
+ */
+static void
+selectRanks(uint64_t* begin, uint64_t* end, const size_t* ranks,
+            size_t numRanks, size_t offset) {
+    while (numRanks > 0 && end - begin > 1) {
+        // Partition around the rank closest to the middle of the range, so
+        // that each step roughly halves the number of elements left to
+        // examine.
+        size_t target = offset + (end - begin) / 2;
+        size_t middle = std::lower_bound(ranks, ranks + numRanks, target) -
+                        ranks;
+        if (middle == numRanks ||
+            (middle > 0 && target - ranks[middle - 1] < ranks[middle] - target))
+            middle--;
+        uint64_t* pivot = begin + (ranks[middle] - offset);
+        std::nth_element(begin, pivot, end);
+
+        // Recurse on the ranks below the pivot and loop on those above it.
+        selectRanks(begin, pivot, ranks, middle, offset);
+        offset = ranks[middle] + 1;
+        begin = pivot + 1;
+        ranks += middle + 1;
+        numRanks -= middle + 1;
+    }
 }
 
-Statistics
-computeStatistics(uint64_t* rawdata, size_t count) {
-    Statistics stats;
+/**
+ * Return the index in a sorted array of count elements at which the given
+ * quantile falls. All of the summary statistics use this convention.
+ */
+static inline size_t
+quantileIndex(size_t count, double quantile) {
+    size_t index =
+        static_cast<size_t>(static_cast<double>(count) * quantile);
+    return index < count ? index : count - 1;
+}
+
+/**
+ * Partition rawdata so that each of the given indices holds the element that
+ * would be there if rawdata were sorted. The indices may be in any order and
+ * may contain duplicates.
+ */
+static void
+selectIndices(uint64_t* rawdata, size_t count, const size_t* indices,
+              size_t numIndices) {
+    std::vector<size_t> ranks(indices, indices + numIndices);
+    std::sort(ranks.begin(), ranks.end());
+    ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+    selectRanks(rawdata, rawdata + count, ranks.data(), ranks.size(), 0);
+}
+
+/**
+ * Does most of the work of the computeStatistics variants: computes the
+ * fixed statistics and, in the same selection pass, places the elements for
+ * extraIndices at their sorted positions. If moments is not NULL, it is
+ * filled in with the moments of the data.
+ */
+static Statistics
+computeStatisticsInternal(uint64_t* rawdata, size_t count,
+                          const std::vector<size_t>& extraIndices,
+                          PerfUtils::Moments* moments = NULL) {
+    Statistics stats = Statistics();
     if (count == 0)
         return stats;
-    qsort(rawdata, count, sizeof(uint64_t), compare);
-    uint64_t sum = 0;
-    for (size_t i = 0; i < count; i++)
-        sum += rawdata[i];
+
+    PerfUtils::Moments localMoments;
+    if (moments == NULL)
+        moments = &localMoments;
+    // The average comes from the exact sum rather than from the mean in
+    // moments, which can fall just short of an integer through rounding.
+    unsigned __int128 sum = 0;
+    moments->record(rawdata, count, &sum);
     stats.count = count;
-    stats.average = sum / count;
-    stats.stddev = 0;
-    for (size_t i = 0; i < count; i++) {
-        uint64_t diff = rawdata[i] > stats.average ? rawdata[i] - stats.average
-            : stats.average - rawdata[i];
-        stats.stddev += diff * diff;
+    stats.average = static_cast<uint64_t>(sum / count);
+    stats.stddev = static_cast<uint64_t>(moments->getStddev());
+
+    // Only a handful of order statistics are needed, so select them rather
+    // than sorting the whole array.
+    uint64_t* outputs[] = {&stats.min, &stats.P10, &stats.P20, &stats.P30,
+                           &stats.P40, &stats.P50, &stats.P60, &stats.P70,
+                           &stats.P80, &stats.P90, &stats.P99, &stats.P999,
+                           &stats.P9999, &stats.max};
+    static const size_t numOutputs = sizeof(outputs) / sizeof(outputs[0]);
+    size_t fixedIndices[numOutputs] = {
+        0,
+        quantileIndex(count, 0.1),
+        quantileIndex(count, 0.2),
+        quantileIndex(count, 0.3),
+        quantileIndex(count, 0.4),
+        count / 2,
+        quantileIndex(count, 0.6),
+        quantileIndex(count, 0.7),
+        quantileIndex(count, 0.8),
+        quantileIndex(count, 0.9),
+        quantileIndex(count, 0.99),
+        quantileIndex(count, 0.999),
+        quantileIndex(count, 0.9999),
+        count - 1};
+    std::vector<size_t> indices(fixedIndices, fixedIndices + numOutputs);
+    indices.insert(indices.end(), extraIndices.begin(), extraIndices.end());
+    selectIndices(rawdata, count, indices.data(), indices.size());
+    for (size_t i = 0; i < numOutputs; i++)
+        *outputs[i] = rawdata[fixedIndices[i]];
+    stats.median = stats.P50;
+    return stats;
+}
+
+Statistics
+computeStatistics(uint64_t* rawdata, size_t count) {
+    return computeStatisticsInternal(rawdata, count, std::vector<size_t>());
+}
+
+/**
+ * Return the element of rank rank (counting from 0) among the union of
+ * several sorted runs, by binary searching on the value rather than
+ * merging the runs.
+ */
+static uint64_t
+valueAtRank(const std::vector<std::pair<uint64_t*, uint64_t*>>& runs,
+            uint64_t low, uint64_t high, size_t rank) {
+    // Find the smallest value v such that more than rank elements are no
+    // larger than v; it is always one of the elements.
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        size_t atMost = 0;
+        for (size_t i = 0; i < runs.size(); i++) {
+            atMost += std::upper_bound(runs[i].first, runs[i].second, middle) -
+                      runs[i].first;
+        }
+        if (atMost > rank)
+            high = middle;
+        else
+            low = middle + 1;
     }
-    stats.stddev /= count;
-    stats.stddev = static_cast<uint64_t>(sqrt(stats.stddev));
-    stats.min = rawdata[0];
-    stats.median = rawdata[count / 2];
-    stats.P10 = rawdata[static_cast<int>(static_cast<double>(count) * 0.1)];
-    stats.P20 = rawdata[static_cast<int>(static_cast<double>(count) * 0.2)];
-    stats.P30 = rawdata[static_cast<int>(static_cast<double>(count) * 0.3)];
-    stats.P40 = rawdata[static_cast<int>(static_cast<double>(count) * 0.4)];
-    stats.P50 = rawdata[static_cast<int>(static_cast<double>(count) * 0.5)];
-    stats.P60 = rawdata[static_cast<int>(static_cast<double>(count) * 0.6)];
-    stats.P70 = rawdata[static_cast<int>(static_cast<double>(count) * 0.7)];
-    stats.P80 = rawdata[static_cast<int>(static_cast<double>(count) * 0.8)];
-    stats.P90 = rawdata[static_cast<int>(static_cast<double>(count) * 0.9)];
-    stats.P99 = rawdata[static_cast<int>(static_cast<double>(count) * 0.99)];
-    stats.P999 = rawdata[static_cast<int>(static_cast<double>(count) * 0.999)];
-    stats.P9999 =
-        rawdata[static_cast<int>(static_cast<double>(count) * 0.9999)];
-    stats.max = rawdata[count - 1];
+    return low;
+}
+
+/**
+ * Does the work of the parallel computeStatistics variants.
+ *
+ * The array is divided into one contiguous range per thread, aligned to
+ * Moments::CHUNK_SIZE. Each thread summarizes the moments of its chunks and
+ * then sorts its range. The chunk moments are merged in the same order that
+ * Moments::record uses, and each order statistic is found by binary
+ * searching for it across the sorted ranges, so the result is exactly the
+ * same as the serial computeStatistics.
+ */
+static Statistics
+computeStatisticsOnThreads(uint64_t* rawdata, size_t count, int numThreads,
+                           const std::vector<int>* cores) {
+    size_t numChunks =
+        (count + PerfUtils::Moments::CHUNK_SIZE - 1) /
+        PerfUtils::Moments::CHUNK_SIZE;
+    if (numThreads <= 1 || numChunks <= 1)
+        return computeStatistics(rawdata, count);
+    if (static_cast<size_t>(numThreads) > numChunks)
+        numThreads = static_cast<int>(numChunks);
+
+    uint64_t origin = rawdata[0];
+    std::vector<PerfUtils::Moments> chunkMoments(numChunks);
+    std::vector<unsigned __int128> chunkSums(numChunks);
+    std::vector<std::pair<uint64_t*, uint64_t*>> runs(numThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        size_t firstChunk = numChunks * t / numThreads;
+        size_t lastChunk = numChunks * (t + 1) / numThreads;
+        uint64_t* begin =
+            rawdata + firstChunk * PerfUtils::Moments::CHUNK_SIZE;
+        uint64_t* end = std::min(
+            rawdata + lastChunk * PerfUtils::Moments::CHUNK_SIZE,
+            rawdata + count);
+        runs[t] = std::make_pair(begin, end);
+        int core = cores == NULL ? -1 : (*cores)[t];
+        threads.emplace_back([=, &chunkMoments, &chunkSums] {
+            if (core >= 0)
+                PerfUtils::Util::pinThreadToCore(core);
+            for (size_t c = firstChunk; c < lastChunk; c++) {
+                uint64_t* chunk =
+                    rawdata + c * PerfUtils::Moments::CHUNK_SIZE;
+                chunkMoments[c] = PerfUtils::Moments::ofSamples(
+                    chunk, std::min(end - chunk, static_cast<ptrdiff_t>(
+                                        PerfUtils::Moments::CHUNK_SIZE)),
+                    origin, &chunkSums[c]);
+            }
+            std::sort(begin, end);
+        });
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    PerfUtils::Moments moments;
+    for (size_t c = 0; c < numChunks; c++)
+        moments.add(chunkMoments[c]);
+    moments.offset(static_cast<double>(origin));
+    unsigned __int128 sum = 0;
+    for (size_t c = 0; c < numChunks; c++)
+        sum += chunkSums[c];
+
+    Statistics stats = Statistics();
+    stats.count = count;
+    stats.average = static_cast<uint64_t>(sum / count);
+    stats.stddev = static_cast<uint64_t>(moments.getStddev());
+    stats.min = runs[0].first[0];
+    stats.max = runs[0].second[-1];
+    for (size_t t = 1; t < runs.size(); t++) {
+        stats.min = std::min(stats.min, runs[t].first[0]);
+        stats.max = std::max(stats.max, runs[t].second[-1]);
+    }
+
+    uint64_t* outputs[] = {&stats.P10, &stats.P20, &stats.P30, &stats.P40,
+                           &stats.P50, &stats.P60, &stats.P70, &stats.P80,
+                           &stats.P90, &stats.P99, &stats.P999, &stats.P9999};
+    size_t ranks[] = {
+        quantileIndex(count, 0.1),
+        quantileIndex(count, 0.2),
+        quantileIndex(count, 0.3),
+        quantileIndex(count, 0.4),
+        count / 2,
+        quantileIndex(count, 0.6),
+        quantileIndex(count, 0.7),
+        quantileIndex(count, 0.8),
+        quantileIndex(count, 0.9),
+        quantileIndex(count, 0.99),
+        quantileIndex(count, 0.999),
+        quantileIndex(count, 0.9999)};
+    for (size_t i = 0; i < sizeof(ranks) / sizeof(ranks[0]); i++)
+        *outputs[i] = valueAtRank(runs, stats.min, stats.max, ranks[i]);
+    stats.median = stats.P50;
     return stats;
 }
 
+Statistics
+computeStatisticsParallel(uint64_t* rawdata, size_t count, int numThreads) {
+    return computeStatisticsOnThreads(rawdata, count, numThreads, NULL);
+}
+
+/**
+ * Compute the same statistics as computeStatistics using one thread pinned
+ * to each of the given cores; for example, the cores returned by
+ * Util::getAllUseableCores.
+ */
+Statistics
+computeStatisticsParallel(uint64_t* rawdata, size_t count,
+                          const std::vector<int>& cores) {
+    return computeStatisticsOnThreads(rawdata, count,
+                                      static_cast<int>(cores.size()), &cores);
+}
+
+/**
+ * Compute the fixed summary statistics together with the values at an
+ * arbitrary list of quantiles, using a single selection pass over rawdata.
+ * Like computeStatistics, this reorders rawdata.
+ *
+ * \param rawdata
+ *      The samples to summarize.
+ * \param count
+ *      Number of samples in rawdata.
+ * \param quantiles
+ *      Fractions between 0 and 1 at which to report values; for example,
+ *      0.99999 for P99.999.
+ */
+ExtendedStatistics
+computeStatistics(uint64_t* rawdata, size_t count,
+                  const std::vector<double>& quantiles) {
+    ExtendedStatistics stats;
+    stats.base = Statistics();
+    stats.skewness = 0;
+    stats.kurtosis = 0;
+    stats.quantiles = quantiles;
+    stats.values.resize(quantiles.size(), 0);
+    if (count == 0)
+        return stats;
+    std::vector<size_t> indices(quantiles.size());
+    for (size_t i = 0; i < quantiles.size(); i++)
+        indices[i] = quantileIndex(count, quantiles[i]);
+    PerfUtils::Moments moments;
+    stats.base = computeStatisticsInternal(rawdata, count, indices, &moments);
+    stats.skewness = moments.getSkewness();
+    stats.kurtosis = moments.getKurtosis();
+    for (size_t i = 0; i < quantiles.size(); i++)
+        stats.values[i] = rawdata[indices[i]];
+    return stats;
+}
+
+void
+computeQuantiles(uint64_t* rawdata, size_t count, const double* quantiles,
+                 size_t numQuantiles, uint64_t* results) {
+    if (count == 0) {
+        for (size_t i = 0; i < numQuantiles; i++)
+            results[i] = 0;
+        return;
+    }
+    std::vector<size_t> indices(numQuantiles);
+    for (size_t i = 0; i < numQuantiles; i++)
+        indices[i] = quantileIndex(count, quantiles[i]);
+    selectIndices(rawdata, count, indices.data(), numQuantiles);
+    for (size_t i = 0; i < numQuantiles; i++)
+        results[i] = rawdata[indices[i]];
+}
+
+double
+computeTrimmedMean(uint64_t* rawdata, size_t count, double lowerFraction,
+                   double upperFraction) {
+    size_t low = static_cast<size_t>(static_cast<double>(count) *
+                                     lowerFraction);
+    size_t high = count - static_cast<size_t>(static_cast<double>(count) *
+                                              upperFraction);
+    if (count == 0 || high <= low)
+        return 0;
+
+    // After selecting the first kept rank and the first discarded rank
+    // above it, exactly the kept samples lie between them.
+    size_t bounds[] = {low, high};
+    selectIndices(rawdata, count, bounds, high < count ? 2 : 1);
+    double sum = 0;
+    for (size_t i = low; i < high; i++)
+        sum += static_cast<double>(rawdata[i]);
+    return sum / static_cast<double>(high - low);
+}
+
 Statistics
 transformStatistics(Statistics stats, uint64_t (*function)(uint64_t)) {
     Statistics result;
@@ -103,9 +404,70 @@ printStatistics(Statistics stats, const char* label) {
 			stats.max);
 }
 
+/**
+ * Apply a transformation function to the fixed statistics and to every
+ * quantile value, usually to change the units. Skewness and kurtosis have
+ * no units, so they are copied unchanged.
+ */
+ExtendedStatistics
+transformStatistics(const ExtendedStatistics& stats,
+                    uint64_t (*function)(uint64_t)) {
+    ExtendedStatistics result;
+    result.base = transformStatistics(stats.base, function);
+    result.skewness = stats.skewness;
+    result.kurtosis = stats.kurtosis;
+    result.quantiles = stats.quantiles;
+    result.values.resize(stats.values.size());
+    for (size_t i = 0; i < stats.values.size(); i++)
+        result.values[i] = function(stats.values[i]);
+    return result;
+}
+
+/**
+ * Print out the statistics in CSV format, with one column for each requested
+ * quantile. A header is printed before the first row, and again whenever the
+ * set of quantiles differs from the previous row's.
+ */
+void
+printStatistics(const ExtendedStatistics& stats, const char* label) {
+    static std::vector<double> headerQuantiles;
+    static bool headerPrinted = false;
+    if (!headerPrinted || headerQuantiles != stats.quantiles) {
+        printf("Benchmark,Count,Avg,Stddev,Median,Min");
+        for (size_t i = 0; i < stats.quantiles.size(); i++)
+            printf(",%g%%", stats.quantiles[i] * 100);
+        printf(",Max\n");
+        headerQuantiles = stats.quantiles;
+        headerPrinted = true;
+    }
+    printf("%s,%lu,%lu,%lu,%lu,%lu", label, stats.base.count,
+           stats.base.average, stats.base.stddev, stats.base.median,
+           stats.base.min);
+    for (size_t i = 0; i < stats.values.size(); i++)
+        printf(",%lu", stats.values[i]);
+    printf(",%lu\n", stats.base.max);
+}
+
+/**
+ * Print out the statistics of a set of samples in CSV format, and optionally
+ * save the raw samples.
+ *
+ * \param label
+ *      Name of the benchmark, used in the output and as the file name.
+ * \param rawdata
+ *      The samples, in cycles. They are reordered.
+ * \param count
+ *      Number of samples in rawdata.
+ * \param datadir
+ *      If not NULL, the samples are written to the file datadir/label.
+ * \param format
+ *      How to write the samples. BINARY_SAMPLES records the unit as cycles
+ *      along with this machine's cycle counter frequency; use
+ *      SampleFile::write directly for samples in other units.
+ */
 void
 printStatistics(const char* label, uint64_t* rawdata, size_t count,
-                const char* datadir) {
+                const char* datadir, SampleFormat format) {
     Statistics stats = computeStatistics(rawdata, count);
 	printStatistics(stats, label);
 
@@ -113,6 +475,12 @@ printStatistics(const char* label, uint64_t* rawdata, size_t count,
     if (datadir != NULL) {
         char buf[1024];
         snprintf(buf, sizeof(buf), "%s/%s", datadir, label);
+        if (format == BINARY_SAMPLES) {
+            PerfUtils::SampleFile::write(buf, label, "cycles",
+                                         PerfUtils::Cycles::perSecond(),
+                                         rawdata, count);
+            return;
+        }
         ensureParents(buf);
         FILE* fp = fopen(buf, "w");
         for (size_t i = 0; i < count; i++)
@@ -121,29 +489,266 @@ printStatistics(const char* label, uint64_t* rawdata, size_t count,
     }
 }
 
-void
-printHistogram(uint64_t* rawdata, size_t count, uint64_t lowerbound,
-               uint64_t upperbound, uint64_t step) {
-    size_t numBuckets = (upperbound - lowerbound) / step + 1;
-    uint64_t* buckets =
-        reinterpret_cast<uint64_t*>(calloc(numBuckets, sizeof(uint64_t)));
-    for (size_t i = 0; i < count; i++) {
-        bool foundBucket = false;
-        for (uint64_t k = lowerbound; k < upperbound; k += step) {
-            if (rawdata[i] < k + step) {
-                buckets[(k - lowerbound) / step]++;
-                foundBucket = true;
-                break;
+/**
+ * Everything needed to map a sample to its bucket with a few arithmetic
+ * operations, rather than by searching the bucket boundaries.
+ */
+struct BucketMap {
+    HistogramScale scale;
+
+    // For LINEAR_SCALE, the start of the first bucket, the bucket width and
+    // its reciprocal.
+    uint64_t lowerbound;
+    uint64_t step;
+    double inverseStep;
+
+    // For the log scales, the exponent of the first bucket.
+    int firstExponent;
+
+    // Index of the last (overflow) bucket; larger indices are clamped to it.
+    uint64_t lastIndex;
+};
+
+static const uint64_t powersOf10[] = {
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL,
+    10000000000000000ULL,
+    100000000000000000ULL,
+    1000000000000000000ULL,
+    10000000000000000000ULL};
+
+/**
+ * Return floor(log10(value)), treating 0 as if it were 1.
+ */
+static inline int
+floorLog10(uint64_t value) {
+    // 1233 / 4096 is just above log10(2), so this is either the answer or
+    // one too large. Setting the low bit changes neither, since every
+    // power of ten above 1 is even.
+    value |= 1;
+    int guess = ((64 - __builtin_clzll(value)) * 1233) >> 12;
+    return guess - (value < powersOf10[guess]);
+}
+
+/**
+ * Compute the bucket index of each of count samples. The loops have no
+ * data-dependent branches, and on x86 a second copy of this function is
+ * compiled for AVX2 and selected at load time on machines that support it.
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+__attribute__((target_clones("avx2", "default")))
+#endif
+static void
+computeBucketIndices(const BucketMap& map, const uint64_t* rawdata,
+                     size_t count, uint32_t* indices) {
+    uint64_t lastIndex = map.lastIndex;
+    switch (map.scale) {
+        case LINEAR_SCALE: {
+            uint64_t lowerbound = map.lowerbound;
+            uint64_t step = map.step;
+            uint64_t limit = lastIndex * step;
+            double inverseStep = map.inverseStep;
+            for (size_t i = 0; i < count; i++) {
+                uint64_t value = rawdata[i];
+                uint64_t offset = value > lowerbound ? value - lowerbound : 0;
+                offset = offset < limit ? offset : limit;
+
+                // The estimate from the reciprocal can be off by one either
+                // way, so fix it up exactly; clamping it first keeps the
+                // products below limit, so they cannot overflow.
+                uint64_t index = static_cast<uint64_t>(
+                    static_cast<double>(offset) * inverseStep);
+                index = index < lastIndex ? index : lastIndex;
+                index -= index * step > offset;
+                index += index < lastIndex && (index + 1) * step <= offset;
+                indices[i] = static_cast<uint32_t>(index);
+            }
+            break;
+        }
+        case LOG2_SCALE: {
+            int64_t first = map.firstExponent;
+            for (size_t i = 0; i < count; i++) {
+                int64_t index = 63 - __builtin_clzll(rawdata[i] | 1) - first;
+                index = index > 0 ? index : 0;
+                indices[i] = static_cast<uint32_t>(
+                    static_cast<uint64_t>(index) < lastIndex ? index
+                                                             : lastIndex);
             }
+            break;
+        }
+        case LOG10_SCALE: {
+            int64_t first = map.firstExponent;
+            for (size_t i = 0; i < count; i++) {
+                int64_t index = floorLog10(rawdata[i]) - first;
+                index = index > 0 ? index : 0;
+                indices[i] = static_cast<uint32_t>(
+                    static_cast<uint64_t>(index) < lastIndex ? index
+                                                             : lastIndex);
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Count the samples that fall into each of a set of buckets. The bucket of
+ * each sample is computed arithmetically, so this runs in O(count) time
+ * regardless of the number of buckets.
+ *
+ * \param rawdata
+ *      The samples to count.
+ * \param count
+ *      Number of samples in rawdata.
+ * \param scale
+ *      How the bucket boundaries are spaced.
+ * \param lowerbound
+ *      Start of the first bucket. For the log scales this is rounded down to
+ *      a power of the base (or 0), and to at most 2^62 or 10^18 so that the
+ *      largest power below 2^64 still starts the overflow bucket. Samples
+ *      below it are counted in the first bucket.
+ * \param upperbound
+ *      Samples at or above this value are counted in a final overflow
+ *      bucket. For LINEAR_SCALE it is rounded up to a whole number of steps
+ *      (or down, if rounding up would pass the largest uint64_t), and for
+ *      the log scales up to a power of the base.
+ * \param step
+ *      Width of each bucket for LINEAR_SCALE; ignored otherwise.
+ */
+HistogramBuckets
+computeHistogram(const uint64_t* rawdata, size_t count, HistogramScale scale,
+                 uint64_t lowerbound, uint64_t upperbound, uint64_t step) {
+    if (upperbound <= lowerbound)
+        PERFUTILS_DIE("computeHistogram: upperbound %lu must be larger than "
+                      "lowerbound %lu", upperbound, lowerbound);
+
+    BucketMap map = BucketMap();
+    map.scale = scale;
+    HistogramBuckets buckets;
+    switch (scale) {
+        case LINEAR_SCALE: {
+            if (step == 0)
+                PERFUTILS_DIE("computeHistogram: step must be positive");
+            map.lowerbound = lowerbound;
+            map.step = step;
+            map.inverseStep = 1.0 / static_cast<double>(step);
+            // Round the range up to whole steps, unless the overflow
+            // bucket would then start beyond the largest uint64_t.
+            uint64_t range = upperbound - lowerbound;
+            map.lastIndex = range / step;
+            if (range % step != 0 &&
+                map.lastIndex < (UINT64_MAX - lowerbound) / step)
+                map.lastIndex++;
+            if (map.lastIndex >= UINT32_MAX)
+                PERFUTILS_DIE("computeHistogram: too many buckets (%lu)",
+                              map.lastIndex + 1);
+            for (uint64_t i = 0; i <= map.lastIndex; i++)
+                buckets.lowerBounds.push_back(lowerbound + i * step);
+            break;
+        }
+        case LOG2_SCALE: {
+            // Leave room above the first bucket for the overflow bucket.
+            map.firstExponent = 63 - __builtin_clzll(lowerbound | 1);
+            map.firstExponent =
+                map.firstExponent < 62 ? map.firstExponent : 62;
+            int lastExponent = 64 - __builtin_clzll((upperbound - 1) | 1);
+            lastExponent = lastExponent < 63 ? lastExponent : 63;
+            map.lastIndex = lastExponent > map.firstExponent
+                                ? lastExponent - map.firstExponent
+                                : 1;
+            for (uint64_t i = 0; i <= map.lastIndex; i++)
+                buckets.lowerBounds.push_back(1ULL
+                                              << (map.firstExponent + i));
+            break;
         }
-        if (!foundBucket) {
-            buckets[numBuckets - 1]++;
+        case LOG10_SCALE: {
+            map.firstExponent = floorLog10(lowerbound);
+            map.firstExponent =
+                map.firstExponent < 18 ? map.firstExponent : 18;
+            int lastExponent = floorLog10(upperbound - 1) + 1;
+            lastExponent = lastExponent < 19 ? lastExponent : 19;
+            map.lastIndex = lastExponent > map.firstExponent
+                                ? lastExponent - map.firstExponent
+                                : 1;
+            for (uint64_t i = 0; i <= map.lastIndex; i++)
+                buckets.lowerBounds.push_back(
+                    powersOf10[map.firstExponent + i]);
+            break;
         }
     }
+    if (scale != LINEAR_SCALE && lowerbound == 0)
+        buckets.lowerBounds[0] = 0;
 
-    for (uint64_t k = lowerbound; k < upperbound; k += step) {
-        printf("%lu-%lu: %lu\n", k, k + step, buckets[(k - lowerbound) / step]);
+    // Compute indices a block at a time so that the index computation can
+    // be vectorized, while the counting itself stays in cache.
+    buckets.counts.resize(map.lastIndex + 1, 0);
+    buckets.total = count;
+    static const size_t blockSize = 1024;
+    uint32_t indices[blockSize];
+    uint64_t* counts = buckets.counts.data();
+    for (size_t start = 0; start < count; start += blockSize) {
+        size_t length = count - start < blockSize ? count - start : blockSize;
+        computeBucketIndices(map, rawdata + start, length, indices);
+        for (size_t i = 0; i < length; i++)
+            counts[indices[i]]++;
+    }
+    return buckets;
+}
+
+/**
+ * Print bucket counts in CSV format, with the cumulative count and the
+ * cumulative fraction of samples (the CDF) for each bucket. The Upper
+ * column of the last bucket is empty, since it has no upper bound.
+ */
+void
+printHistogram(const HistogramBuckets& buckets) {
+    printf("Lower,Upper,Count,Cumulative,CDF\n");
+    uint64_t cumulative = 0;
+    size_t numBuckets = buckets.counts.size();
+    for (size_t i = 0; i < numBuckets; i++) {
+        cumulative += buckets.counts[i];
+        double cdf = buckets.total == 0
+                         ? 0
+                         : static_cast<double>(cumulative) /
+                               static_cast<double>(buckets.total);
+        if (i + 1 < numBuckets) {
+            printf("%lu,%lu,%lu,%lu,%.6f\n", buckets.lowerBounds[i],
+                   buckets.lowerBounds[i + 1], buckets.counts[i], cumulative,
+                   cdf);
+        } else {
+            printf("%lu,,%lu,%lu,%.6f\n", buckets.lowerBounds[i],
+                   buckets.counts[i], cumulative, cdf);
+        }
+    }
+}
+
+/**
+ * Print a histogram with linear buckets of width step between lowerbound
+ * and upperbound, one "low-high: count" line per bucket, followed by a
+ * "upperbound+: count" line for the samples at or above upperbound.
+ */
+void
+printHistogram(uint64_t* rawdata, size_t count, uint64_t lowerbound,
+               uint64_t upperbound, uint64_t step) {
+    HistogramBuckets buckets = computeHistogram(rawdata, count, LINEAR_SCALE,
+                                                lowerbound, upperbound, step);
+    size_t last = buckets.counts.size() - 1;
+    for (size_t i = 0; i < last; i++) {
+        printf("%lu-%lu: %lu\n", buckets.lowerBounds[i],
+               buckets.lowerBounds[i] + step, buckets.counts[i]);
     }
-    printf("%lu+: %lu\n", upperbound, buckets[numBuckets - 1]);
-    free(buckets);
+    printf("%lu+: %lu\n", buckets.lowerBounds[last], buckets.counts[last]);
 }
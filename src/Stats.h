@@ -16,11 +16,83 @@
 #ifndef PERFUTILS_STATS_H
 #define PERFUTILS_STATS_H
 
+#include <vector>
+
 #include "StatsMinimal.h"
 
+/**
+ * Summary statistics together with the values at a caller-chosen list of
+ * quantiles, for reports that need more than the fixed fields of Statistics.
+ */
+struct ExtendedStatistics {
+    // The fixed statistics, exactly as computeStatistics reports them.
+    Statistics base;
+
+    // Shape of the distribution: skewness is positive for a long upper
+    // tail, and excess kurtosis is 0 for a normal distribution.
+    double skewness;
+    double kurtosis;
+
+    // Requested quantiles, as fractions between 0 and 1, in the order the
+    // caller gave them.
+    std::vector<double> quantiles;
+
+    // values[i] is the value at quantiles[i].
+    std::vector<uint64_t> values;
+};
+
+Statistics computeStatisticsParallel(uint64_t* rawdata, size_t count,
+                                     const std::vector<int>& cores);
+ExtendedStatistics computeStatistics(uint64_t* rawdata, size_t count,
+                                     const std::vector<double>& quantiles);
+ExtendedStatistics transformStatistics(const ExtendedStatistics& stats,
+                                       uint64_t (*function)(uint64_t));
+void printStatistics(const ExtendedStatistics& stats, const char* label);
+
+/**
+ * How printStatistics writes raw samples to its datadir.
+ */
+enum SampleFormat {
+    // One decimal sample per line.
+    TEXT_SAMPLES,
+    // A PerfUtils::SampleFile, which can be mapped back in without parsing.
+    BINARY_SAMPLES
+};
+
 void printStatistics(const char* label, uint64_t* rawdata, size_t count,
-                     const char* datadir = NULL);
+                     const char* datadir = NULL,
+                     SampleFormat format = TEXT_SAMPLES);
+
+/**
+ * How computeHistogram spaces its bucket boundaries.
+ */
+enum HistogramScale {
+    // Buckets of equal width.
+    LINEAR_SCALE,
+    // One bucket per power of two.
+    LOG2_SCALE,
+    // One bucket per power of ten.
+    LOG10_SCALE
+};
+
+/**
+ * Bucket counts produced by computeHistogram. Bucket i counts the samples in
+ * [lowerBounds[i], lowerBounds[i + 1]). The first bucket also counts any
+ * samples below lowerBounds[0], and the last bucket counts every sample from
+ * lowerBounds.back() upwards.
+ */
+struct HistogramBuckets {
+    std::vector<uint64_t> lowerBounds;
+    std::vector<uint64_t> counts;
+
+    // Total number of samples counted.
+    uint64_t total;
+};
 
+HistogramBuckets computeHistogram(const uint64_t* rawdata, size_t count,
+                                  HistogramScale scale, uint64_t lowerbound,
+                                  uint64_t upperbound, uint64_t step = 1);
+void printHistogram(const HistogramBuckets& buckets);
 void printHistogram(uint64_t* rawdata, size_t count, uint64_t lowerbound,
                     uint64_t upperbound, uint64_t step);
 
@@ -0,0 +1,118 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * This program measures how long computeStatistics takes on sample arrays of
+ * increasing size, and compares it against sorting the whole array first,
+ * both with qsort (the original implementation) and with std::sort. It
+ * also times computeStatisticsParallel with 2 to 32 threads, to show how it
+ * scales, and computeHistogram with 10000 linear buckets.
+ *
+ * Usage: StatsBenchmark [maxCount]
+ *
+ * Sizes run from 1e3 up to maxCount (default 1e9) in powers of ten. Sizes
+ * whose arrays cannot be allocated are skipped. Results are printed as CSV,
+ * in seconds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+#include <random>
+
+#include "Cycles.h"
+#include "Stats.h"
+
+using PerfUtils::Cycles;
+
+/**
+ * Comparator used by the qsort-based reference implementation.
+ */
+static int
+compare(const void* a, const void* b) {
+    if (*(const uint64_t*)a == *(const uint64_t*)b)
+        return 0;
+    return *(const uint64_t*)a < *(const uint64_t*)b ? -1 : 1;
+}
+
+/**
+ * Time one way of computing statistics on a private copy of samples, and
+ * return the elapsed time in seconds.
+ */
+template <typename Function>
+static double
+timeMethod(Function method, const uint64_t* samples, uint64_t* scratch,
+           size_t count) {
+    memcpy(scratch, samples, count * sizeof(uint64_t));
+    uint64_t start = Cycles::rdtsc();
+    method(scratch, count);
+    return Cycles::toSeconds(Cycles::rdtsc() - start);
+}
+
+int
+main(int argc, char** argv) {
+    size_t maxCount = 1000000000UL;
+    if (argc > 1)
+        maxCount = strtoul(argv[1], NULL, 0);
+
+    std::mt19937_64 generator(12345);
+    std::lognormal_distribution<double> latency(7.0, 1.0);
+
+    printf("Count,Method,Seconds\n");
+    for (size_t count = 1000; count <= maxCount; count *= 10) {
+        uint64_t* samples = new (std::nothrow) uint64_t[count];
+        uint64_t* scratch = new (std::nothrow) uint64_t[count];
+        if (samples == NULL || scratch == NULL) {
+            fprintf(stderr, "Skipping %lu samples: allocation failed\n",
+                    count);
+            delete[] samples;
+            delete[] scratch;
+            continue;
+        }
+        for (size_t i = 0; i < count; i++)
+            samples[i] = static_cast<uint64_t>(latency(generator));
+
+        printf("%lu,computeStatistics,%.6f\n", count,
+               timeMethod([](uint64_t* data, size_t n) {
+                   computeStatistics(data, n);
+               }, samples, scratch, count));
+        for (int threads = 2; threads <= 32; threads *= 2) {
+            printf("%lu,computeStatisticsParallel(%d),%.6f\n", count, threads,
+                   timeMethod([threads](uint64_t* data, size_t n) {
+                       computeStatisticsParallel(data, n, threads);
+                   }, samples, scratch, count));
+        }
+        printf("%lu,std::sort,%.6f\n", count,
+               timeMethod([](uint64_t* data, size_t n) {
+                   std::sort(data, data + n);
+               }, samples, scratch, count));
+        printf("%lu,qsort,%.6f\n", count,
+               timeMethod([](uint64_t* data, size_t n) {
+                   qsort(data, n, sizeof(uint64_t), compare);
+               }, samples, scratch, count));
+        printf("%lu,computeHistogram,%.6f\n", count,
+               timeMethod([](uint64_t* data, size_t n) {
+                   computeHistogram(data, n, LINEAR_SCALE, 0, 100000, 10);
+               }, samples, scratch, count));
+        fflush(stdout);
+
+        delete[] samples;
+        delete[] scratch;
+    }
+    return 0;
+}
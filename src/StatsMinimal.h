@@ -48,8 +48,41 @@ struct Statistics {
     uint64_t max;
 };
 
+/**
+ * Compute summary statistics over count samples. The samples are reordered
+ * in place: the order statistics are found by selection rather than by
+ * sorting, so rawdata is left partitioned around them but not sorted.
+ */
 struct Statistics computeStatistics(uint64_t* rawdata, size_t count);
 
+/**
+ * Compute the same statistics as computeStatistics using numThreads threads;
+ * the result is exactly the same as the serial version's. Each thread sorts
+ * its share of rawdata, which costs about twice as much as the serial
+ * selection, so this only pays off with three or more cores. Arrays too
+ * small to split are summarized by the calling thread. rawdata is left as
+ * numThreads sorted runs.
+ */
+struct Statistics computeStatisticsParallel(uint64_t* rawdata, size_t count,
+                                            int numThreads);
+
+/**
+ * Compute the values at an arbitrary list of quantiles in a single selection
+ * pass, without computing the other statistics. results[i] receives the value
+ * at quantiles[i], using the same rank convention as computeStatistics. Like
+ * computeStatistics, this reorders rawdata.
+ */
+void computeQuantiles(uint64_t* rawdata, size_t count, const double* quantiles,
+                      size_t numQuantiles, uint64_t* results);
+
+/**
+ * Return the mean of the samples left after discarding the lowest
+ * lowerFraction and the highest upperFraction of them; for example, 0.01 and
+ * 0.01 give the 1% trimmed mean. This reorders rawdata.
+ */
+double computeTrimmedMean(uint64_t* rawdata, size_t count,
+                          double lowerFraction, double upperFraction);
+
 
 /**
  * Apply a transformation function on all statistics, usually to change the
@@ -16,10 +16,16 @@
 #include "Stats.h"
 
 #include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
+#include <vector>
+
+#include "Util.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -44,6 +50,33 @@ TEST(StatsTest, allStats) {
     EXPECT_EQ(28, stats.stddev);
 }
 
+TEST(StatsTest, largeOutliersDoNotOverflow) {
+    // The squared deviation of the outlier alone does not fit in 64 bits.
+    const int numElements = 4;
+    uint64_t input[numElements] = {100, 100, 100, 1ULL << 40};
+    Statistics stats = computeStatistics(input, numElements);
+    EXPECT_EQ((1ULL << 40) / 4 + 75, stats.average);
+    EXPECT_NEAR(sqrt(3.0) / 4 * static_cast<double>((1ULL << 40) - 100),
+                static_cast<double>(stats.stddev), 1);
+
+    // The average is exact even where a double is not, and even if the sum
+    // does not fit in 64 bits.
+    std::vector<uint64_t> large(200000, (1ULL << 60) + 1);
+    large[0] = (1ULL << 60) + 3;
+    stats = computeStatistics(large.data(), large.size());
+    EXPECT_EQ((1ULL << 60) + 1, stats.average);
+    EXPECT_EQ((1ULL << 60) + 1, computeStatisticsParallel(
+                                    large.data(), large.size(), 2).average);
+    uint64_t maximal[] = {~0ULL, ~0ULL};
+    EXPECT_EQ(~0ULL, computeStatistics(maximal, 2).average);
+
+    std::vector<double> quantiles;
+    ExtendedStatistics extended =
+        computeStatistics(input, numElements, quantiles);
+    EXPECT_NEAR(1.1547, extended.skewness, 1e-4);
+    EXPECT_NEAR(-0.6667, extended.kurtosis, 1e-4);
+}
+
 TEST(StatsTest, transformStatistics) {
     const int numElements = 100;
     uint64_t input[numElements];
@@ -71,3 +104,256 @@ TEST(StatsTest, transformStatistics) {
     EXPECT_EQ(half(stats.P9999), halfStats.P9999);
     EXPECT_EQ(half(stats.max), halfStats.max);
 }
+
+TEST(StatsTest, matchesSortedReference) {
+    // Exercise small sizes, where several quantiles share a rank, as well as
+    // inputs with many duplicates.
+    srand(7);
+    for (size_t count = 1; count < 2000; count += count / 3 + 1) {
+        std::vector<uint64_t> input(count);
+        for (size_t i = 0; i < count; i++)
+            input[i] = rand() % (count / 2 + 1);
+        std::vector<uint64_t> sorted(input);
+        std::sort(sorted.begin(), sorted.end());
+
+        Statistics stats = computeStatistics(input.data(), count);
+        EXPECT_EQ(count, stats.count);
+        EXPECT_EQ(sorted[0], stats.min);
+        EXPECT_EQ(sorted[count / 2], stats.median);
+        EXPECT_EQ(sorted[count / 2], stats.P50);
+        EXPECT_EQ(sorted[static_cast<size_t>(count * 0.1)], stats.P10);
+        EXPECT_EQ(sorted[static_cast<size_t>(count * 0.3)], stats.P30);
+        EXPECT_EQ(sorted[static_cast<size_t>(count * 0.9)], stats.P90);
+        EXPECT_EQ(sorted[static_cast<size_t>(count * 0.99)], stats.P99);
+        EXPECT_EQ(sorted[static_cast<size_t>(count * 0.999)], stats.P999);
+        EXPECT_EQ(sorted[static_cast<size_t>(count * 0.9999)], stats.P9999);
+        EXPECT_EQ(sorted[count - 1], stats.max);
+
+        // The input is reordered but must still hold the same values.
+        std::sort(input.begin(), input.end());
+        EXPECT_EQ(sorted, input);
+    }
+}
+
+TEST(StatsTest, emptyInput) {
+    Statistics stats = computeStatistics(NULL, 0);
+    EXPECT_EQ(0U, stats.count);
+    EXPECT_EQ(0U, stats.max);
+}
+
+TEST(StatsTest, computeQuantiles) {
+    const int numElements = 1000;
+    uint64_t input[numElements];
+    for (uint64_t i = 0; i < numElements; i++)
+        input[i] = numElements - 1 - i;
+    double quantiles[] = {0.99999, 0.5, 0, 0.25, 1.0};
+    uint64_t results[5];
+    computeQuantiles(input, numElements, quantiles, 5, results);
+    EXPECT_EQ(999U, results[0]);
+    EXPECT_EQ(500U, results[1]);
+    EXPECT_EQ(0U, results[2]);
+    EXPECT_EQ(250U, results[3]);
+    EXPECT_EQ(999U, results[4]);
+}
+
+TEST(StatsTest, extendedStatistics) {
+    const size_t numElements = 1000000;
+    std::vector<uint64_t> input(numElements);
+    for (size_t i = 0; i < numElements; i++)
+        input[i] = (i * 7919) % numElements;
+    std::vector<double> quantiles = {0.99999, 0.95, 0.5};
+    ExtendedStatistics stats =
+        computeStatistics(input.data(), numElements, quantiles);
+    EXPECT_EQ(numElements, stats.base.count);
+    EXPECT_EQ(500000U, stats.base.median);
+    EXPECT_EQ(999900U, stats.base.P9999);
+    EXPECT_EQ(quantiles, stats.quantiles);
+    ASSERT_EQ(3U, stats.values.size());
+    EXPECT_EQ(999990U, stats.values[0]);
+    EXPECT_EQ(950000U, stats.values[1]);
+    EXPECT_EQ(500000U, stats.values[2]);
+
+    ExtendedStatistics halfStats = transformStatistics(stats, half);
+    EXPECT_EQ(half(stats.base.median), halfStats.base.median);
+    EXPECT_EQ(half(stats.values[1]), halfStats.values[1]);
+
+    testing::internal::CaptureStdout();
+    printStatistics(stats, "extended");
+    printStatistics(stats, "again");
+    std::string output = testing::internal::GetCapturedStdout();
+    EXPECT_EQ("Benchmark,Count,Avg,Stddev,Median,Min,99.999%,95%,50%,Max\n"
+              "extended,1000000,499999,288675,500000,0,999990,950000,500000,"
+              "999999\n"
+              "again,1000000,499999,288675,500000,0,999990,950000,500000,"
+              "999999\n",
+              output);
+}
+
+TEST(StatsTest, computeTrimmedMean) {
+    const int numElements = 100;
+    uint64_t input[numElements];
+    for (uint64_t i = 0; i < numElements; i++)
+        input[i] = (i * 37) % numElements;
+    input[0] = 1000000;
+    // The samples are 1..99 and one outlier; trimming the top 10% drops it.
+    EXPECT_DOUBLE_EQ(50.5, computeTrimmedMean(input, numElements, 0.1, 0.1));
+    EXPECT_DOUBLE_EQ(45.5, computeTrimmedMean(input, numElements, 0, 0.1));
+    EXPECT_EQ(0, computeTrimmedMean(input, numElements, 0.5, 0.5));
+}
+
+TEST(StatsTest, computeHistogramLinear) {
+    std::vector<uint64_t> input;
+    srand(3);
+    for (int i = 0; i < 100000; i++)
+        input.push_back(rand() % 12000);
+    // The range is not a whole number of steps, so the last regular bucket
+    // extends past upperbound.
+    HistogramBuckets buckets = computeHistogram(input.data(), input.size(),
+                                                LINEAR_SCALE, 100, 10000, 7);
+    ASSERT_EQ(1416U, buckets.counts.size());
+    EXPECT_EQ(100U, buckets.lowerBounds[0]);
+    EXPECT_EQ(10005U, buckets.lowerBounds.back());
+    EXPECT_EQ(input.size(), buckets.total);
+
+    std::vector<uint64_t> expected(buckets.counts.size(), 0);
+    for (size_t i = 0; i < input.size(); i++) {
+        size_t bucket = 0;
+        while (bucket + 1 < expected.size() &&
+               input[i] >= buckets.lowerBounds[bucket + 1])
+            bucket++;
+        expected[bucket]++;
+    }
+    EXPECT_EQ(expected, buckets.counts);
+}
+
+TEST(StatsTest, computeHistogramLinearExtremeBounds) {
+    uint64_t input[] = {0, 1ULL << 62, ~0ULL};
+    HistogramBuckets buckets =
+        computeHistogram(input, 3, LINEAR_SCALE, 0, ~0ULL, 1ULL << 62);
+    std::vector<uint64_t> bounds = {0, 1ULL << 62, 1ULL << 63,
+                                    3ULL << 62};
+    EXPECT_EQ(bounds, buckets.lowerBounds);
+    std::vector<uint64_t> counts = {1, 1, 0, 1};
+    EXPECT_EQ(counts, buckets.counts);
+
+    // Too many buckets is caught before any are allocated.
+    EXPECT_DEATH(computeHistogram(input, 3, LINEAR_SCALE, 0, ~0ULL, 10),
+                 "too many buckets \\(1844674407370955162\\)");
+}
+
+TEST(StatsTest, computeHistogramLog) {
+    uint64_t input[] = {0, 1, 2, 3, 4, 7, 8, 100, 999, 1000, 5000, ~0ULL};
+    size_t count = sizeof(input) / sizeof(input[0]);
+
+    HistogramBuckets log2 =
+        computeHistogram(input, count, LOG2_SCALE, 2, 1000);
+    std::vector<uint64_t> bounds = {2, 4, 8, 16, 32, 64, 128, 256, 512, 1024};
+    EXPECT_EQ(bounds, log2.lowerBounds);
+    std::vector<uint64_t> counts = {4, 2, 1, 0, 0, 1, 0, 0, 2, 2};
+    EXPECT_EQ(counts, log2.counts);
+
+    HistogramBuckets log10 =
+        computeHistogram(input, count, LOG10_SCALE, 0, 1000);
+    bounds = {0, 10, 100, 1000};
+    EXPECT_EQ(bounds, log10.lowerBounds);
+    counts = {7, 0, 2, 3};
+    EXPECT_EQ(counts, log10.counts);
+}
+
+TEST(StatsTest, computeHistogramLogExtremeBounds) {
+    uint64_t input[] = {0, 1ULL << 62, 1ULL << 63, ~0ULL};
+    size_t count = sizeof(input) / sizeof(input[0]);
+
+    // The first bucket is moved down so that the overflow bucket still
+    // starts at a power of the base below 2^64.
+    HistogramBuckets log2 =
+        computeHistogram(input, count, LOG2_SCALE, 1ULL << 63, ~0ULL);
+    std::vector<uint64_t> bounds = {1ULL << 62, 1ULL << 63};
+    EXPECT_EQ(bounds, log2.lowerBounds);
+    std::vector<uint64_t> counts = {2, 2};
+    EXPECT_EQ(counts, log2.counts);
+
+    HistogramBuckets log10 = computeHistogram(
+        input, count, LOG10_SCALE, 10000000000000000000ULL, ~0ULL);
+    bounds = {1000000000000000000ULL, 10000000000000000000ULL};
+    EXPECT_EQ(bounds, log10.lowerBounds);
+    counts = {3, 1};
+    EXPECT_EQ(counts, log10.counts);
+}
+
+TEST(StatsTest, printHistogram) {
+    uint64_t input[] = {1, 5, 12, 15, 18, 30, 31};
+    testing::internal::CaptureStdout();
+    printHistogram(input, 7, 10, 30, 10);
+    HistogramBuckets buckets =
+        computeHistogram(input, 7, LINEAR_SCALE, 10, 30, 10);
+    printHistogram(buckets);
+    std::string output = testing::internal::GetCapturedStdout();
+    EXPECT_EQ("10-20: 5\n"
+              "20-30: 0\n"
+              "30+: 2\n"
+              "Lower,Upper,Count,Cumulative,CDF\n"
+              "10,20,5,5,0.714286\n"
+              "20,30,0,5,0.714286\n"
+              "30,,2,7,1.000000\n",
+              output);
+}
+
+/**
+ * Check that every field of two Statistics is identical.
+ */
+static void
+expectSameStatistics(const Statistics& expected, const Statistics& actual) {
+    EXPECT_EQ(expected.count, actual.count);
+    EXPECT_EQ(expected.average, actual.average);
+    EXPECT_EQ(expected.stddev, actual.stddev);
+    EXPECT_EQ(expected.min, actual.min);
+    EXPECT_EQ(expected.median, actual.median);
+    EXPECT_EQ(expected.P10, actual.P10);
+    EXPECT_EQ(expected.P20, actual.P20);
+    EXPECT_EQ(expected.P30, actual.P30);
+    EXPECT_EQ(expected.P40, actual.P40);
+    EXPECT_EQ(expected.P50, actual.P50);
+    EXPECT_EQ(expected.P60, actual.P60);
+    EXPECT_EQ(expected.P70, actual.P70);
+    EXPECT_EQ(expected.P80, actual.P80);
+    EXPECT_EQ(expected.P90, actual.P90);
+    EXPECT_EQ(expected.P99, actual.P99);
+    EXPECT_EQ(expected.P999, actual.P999);
+    EXPECT_EQ(expected.P9999, actual.P9999);
+    EXPECT_EQ(expected.max, actual.max);
+}
+
+TEST(StatsTest, computeStatisticsParallel) {
+    // Several chunks, the last of them partial, with many duplicates and a
+    // few huge outliers.
+    const size_t numElements = 300001;
+    std::vector<uint64_t> input(numElements);
+    srand(11);
+    for (size_t i = 0; i < numElements; i++) {
+        input[i] = 1000 + rand() % 5000;
+        if (i % 9973 == 0)
+            input[i] = (1ULL << 40) + i;
+    }
+    std::vector<uint64_t> copy = input;
+    Statistics expected = computeStatistics(copy.data(), numElements);
+
+    for (int numThreads = 1; numThreads <= 8; numThreads++) {
+        copy = input;
+        expectSameStatistics(expected, computeStatisticsParallel(
+            copy.data(), numElements, numThreads));
+    }
+
+    // Pin both threads to the first core this thread may run on.
+    cpu_set_t cpuset = PerfUtils::Util::getCpuAffinity();
+    int core = 0;
+    while (!CPU_ISSET(core, &cpuset))
+        core++;
+    copy = input;
+    expectSameStatistics(expected, computeStatisticsParallel(
+        copy.data(), numElements, std::vector<int>(2, core)));
+
+    uint64_t small[] = {5, 3, 1};
+    expectSameStatistics(computeStatistics(small, 3),
+                         computeStatisticsParallel(small, 3, 4));
+}
@@ -324,6 +324,8 @@ pinAvailableCore() {
  *
  * \param coreId
  *     The coreId whose hypertwin's ID will be returned.
+ * \return
+ *     The physical core, or -1 if the topology of coreId cannot be read.
  */
 int
 getPhysicalCore(int coreId) {
@@ -332,9 +334,13 @@ getPhysicalCore(int coreId) {
                                   std::to_string(coreId) +
                                   "/topology/thread_siblings_list";
     FILE* siblingFile = fopen(siblingFilePath.c_str(), "r");
+    if (siblingFile == NULL)
+        return -1;
     int physicalCoreId;
     // The first cpuid in the file is always that of the physical core
-    fscanf(siblingFile, "%d", &physicalCoreId);
+    if (fscanf(siblingFile, "%d", &physicalCoreId) != 1)
+        physicalCoreId = -1;
+    fclose(siblingFile);
     return physicalCoreId;
 }
 
@@ -345,6 +351,9 @@ getPhysicalCore(int coreId) {
  *
  * \param coreId
  *     The coreId whose hypertwin's ID will be returned.
+ * \return
+ *     The hypertwin, or -1 if coreId has none (for example, because
+ *     hyperthreading is disabled) or its topology cannot be read.
  */
 int
 getHyperTwin(int coreId) {
@@ -353,9 +362,14 @@ getHyperTwin(int coreId) {
                                   std::to_string(coreId) +
                                   "/topology/thread_siblings_list";
     FILE* siblingFile = fopen(siblingFilePath.c_str(), "r");
+    if (siblingFile == NULL)
+        return -1;
     int twin1, twin2;
     // The first cpuid in the file is always that of the physical core
-    fscanf(siblingFile, "%d,%d", &twin1, &twin2);
+    int found = fscanf(siblingFile, "%d,%d", &twin1, &twin2);
+    fclose(siblingFile);
+    if (found != 2)
+        return -1;
     if (coreId == twin1)
         return twin2;
     return twin1;
@@ -125,7 +125,9 @@ pinThreadToCore(int id) {
 
     CPU_ZERO(&cpuset);
     CPU_SET(id, &cpuset);
-    assert(sched_setaffinity(0, sizeof(cpuset), &cpuset) == 0);
+    int result = sched_setaffinity(0, sizeof(cpuset), &cpuset);
+    assert(result == 0);
+    (void) result;
 }
 
 /**
@@ -138,7 +140,9 @@ getCpuAffinity() {
     cpu_set_t cpuset;
 
     CPU_ZERO(&cpuset);
-    assert(sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0);
+    int result = sched_getaffinity(0, sizeof(cpuset), &cpuset);
+    assert(result == 0);
+    (void) result;
     return cpuset;
 }
 
@@ -153,7 +157,9 @@ getCpuAffinity() {
  */
 static FORCE_INLINE void
 setCpuAffinity(cpu_set_t cpuset) {
-    assert(sched_setaffinity(0, sizeof(cpuset), &cpuset) == 0);
+    int result = sched_setaffinity(0, sizeof(cpuset), &cpuset);
+    assert(result == 0);
+    (void) result;
 }
 
 /**
@@ -80,10 +80,20 @@ TEST(UtilTest, readRanges) {
 
 TEST(UtilTest, getHyperTwin) {
     int hyperZero = PerfUtils::Util::getHyperTwin(0);
+    if (hyperZero < 0) {
+        // Without hyperthreading, core 0 is its own physical core.
+        EXPECT_THAT(PerfUtils::Util::getPhysicalCore(0), Eq(0));
+        return;
+    }
     int physicalCore = PerfUtils::Util::getPhysicalCore(hyperZero);
     EXPECT_THAT(physicalCore, Eq(0));
 }
 
+TEST(UtilTest, getHyperTwinMissingCore) {
+    EXPECT_THAT(PerfUtils::Util::getHyperTwin(100000), Eq(-1));
+    EXPECT_THAT(PerfUtils::Util::getPhysicalCore(100000), Eq(-1));
+}
+
 TEST(UtilTest, containerToUnorderedSet) {
     std::vector<int> vec{1, 2, 3};
     std::unordered_set<int> set = PerfUtils::Util::containerToUnorderedSet(vec);
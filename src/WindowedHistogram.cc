@@ -0,0 +1,120 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "WindowedHistogram.h"
+
+#include <math.h>
+
+#include "Util.h"
+
+namespace PerfUtils {
+
+/**
+ * Construct a WindowedHistogram.
+ *
+ * \param intervalSeconds
+ *      Length of each interval. Windows are rounded up to a whole number
+ *      of intervals, so this is the granularity of the windows.
+ * \param numIntervals
+ *      Number of intervals kept; the longest window is
+ *      numIntervals * intervalSeconds.
+ * \param significantDigits
+ *      Precision of each interval's histogram; see Histogram.
+ * \param highestTrackableValue
+ *      Range of each interval's histogram; see Histogram. Lowering it
+ *      reduces the memory used.
+ */
+WindowedHistogram::WindowedHistogram(double intervalSeconds,
+                                     int numIntervals,
+                                     int significantDigits,
+                                     uint64_t highestTrackableValue)
+    : intervalCycles(Cycles::fromSeconds(intervalSeconds)),
+      intervalEnd(0),
+      current(0),
+      intervals() {
+    if (intervalCycles == 0 || numIntervals <= 0)
+        PERFUTILS_DIE("WindowedHistogram needs a positive interval and "
+                      "number of intervals");
+    intervals.resize(numIntervals,
+                     Histogram(significantDigits, highestTrackableValue));
+}
+
+/**
+ * Advance the ring to the interval that contains now, clearing the
+ * intervals that are started along the way. This runs at most once per
+ * interval, and costs no more than clearing the whole ring.
+ */
+void
+WindowedHistogram::rotate(uint64_t now) {
+    if (intervalEnd == 0) {
+        intervalEnd = now + intervalCycles;
+        return;
+    }
+    uint64_t elapsed = (now - intervalEnd) / intervalCycles + 1;
+    uint64_t cleared = elapsed < intervals.size() ? elapsed : intervals.size();
+    for (uint64_t i = 0; i < cleared; i++) {
+        current = (current + 1) % intervals.size();
+        intervals[current].reset();
+    }
+    intervalEnd += elapsed * intervalCycles;
+}
+
+/**
+ * Return the values recorded in the most recent windowSeconds, including
+ * the current, partial interval.
+ *
+ * \param windowSeconds
+ *      Length of the window. It is rounded up to a whole number of
+ *      intervals, and limited to the length of the ring.
+ */
+Histogram
+WindowedHistogram::snapshot(double windowSeconds) {
+    return snapshot(windowSeconds, Cycles::rdtsc());
+}
+
+/**
+ * Return the values recorded in the window of windowSeconds that ends at
+ * the given time; see snapshot(double).
+ */
+Histogram
+WindowedHistogram::snapshot(double windowSeconds, uint64_t now) {
+    if (intervalEnd != 0 && now >= intervalEnd)
+        rotate(now);
+    // Allow for rounding in the conversion to cycles, so that a window of
+    // exactly k intervals doesn't pick up one more.
+    double covered = windowSeconds * Cycles::perSecond() /
+                       static_cast<double>(intervalCycles);
+    uint64_t count = covered <= 1 ? 1 :
+                     static_cast<uint64_t>(ceil(covered - 1e-6));
+    count = count < intervals.size() ? count : intervals.size();
+
+    Histogram result(intervals[current]);
+    for (uint64_t i = 1; i < count; i++) {
+        size_t index = (current + intervals.size() - i) % intervals.size();
+        result.add(intervals[index]);
+    }
+    return result;
+}
+
+/**
+ * Compute summary statistics over the most recent windowSeconds; see
+ * snapshot(double).
+ */
+Statistics
+WindowedHistogram::computeStatistics(double windowSeconds) {
+    return snapshot(windowSeconds).computeStatistics();
+}
+
+}  // namespace PerfUtils
@@ -0,0 +1,108 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PERFUTILS_WINDOWEDHISTOGRAM_H
+#define PERFUTILS_WINDOWEDHISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "Cycles.h"
+#include "Histogram.h"
+
+namespace PerfUtils {
+
+/**
+ * This class keeps the distribution of the values recorded over the recent
+ * past, such as the latencies of a live server over the last 1, 10 and 60
+ * seconds. It holds a ring of Histograms, one per fixed time interval; the
+ * ring is rotated by the cycle counter as values are recorded, and the
+ * oldest interval is discarded when a new one starts. A window of any
+ * length up to the whole ring is summarized by merging the intervals it
+ * covers.
+ *
+ * Recording is O(1), and the memory used is fixed when the object is
+ * created: numIntervals histograms of the given precision and range.
+ *
+ * This class is not thread-safe.
+ */
+class WindowedHistogram {
+  public:
+    WindowedHistogram(double intervalSeconds, int numIntervals,
+                      int significantDigits = 3,
+                      uint64_t highestTrackableValue = UINT64_MAX);
+
+    /**
+     * Record a value in the current interval.
+     */
+    inline void record(uint64_t value) {
+        record(value, Cycles::rdtsc());
+    }
+
+    /**
+     * Record a value in the interval that contains the given time; use this
+     * when the caller has already read the cycle counter, for example at
+     * the end of the operation being timed.
+     *
+     * \param value
+     *      The value to record.
+     * \param now
+     *      The current value of the cycle counter. Times must not go
+     *      backwards from one call to the next.
+     */
+    inline void record(uint64_t value, uint64_t now) {
+        if (now >= intervalEnd)
+            rotate(now);
+        intervals[current].record(value);
+    }
+
+    Histogram snapshot(double windowSeconds);
+    Histogram snapshot(double windowSeconds, uint64_t now);
+    Statistics computeStatistics(double windowSeconds);
+
+    /// Return the length of each interval, in cycles.
+    uint64_t getIntervalCycles() const { return intervalCycles; }
+
+    /// Return the number of intervals in the ring.
+    size_t getNumIntervals() const { return intervals.size(); }
+
+    /// Return the number of bytes used for bucket counts.
+    size_t getMemorySize() const {
+        return intervals.size() * intervals[0].getMemorySize();
+    }
+
+  private:
+    void rotate(uint64_t now);
+
+    // Length of each interval, in cycles.
+    uint64_t intervalCycles;
+
+    // Cycle counter value at which the current interval ends, or 0 before
+    // the first value is recorded.
+    uint64_t intervalEnd;
+
+    // Index in intervals of the current interval; earlier intervals come
+    // before it, wrapping around.
+    size_t current;
+
+    // Values recorded in each interval.
+    std::vector<Histogram> intervals;
+};
+
+}  // namespace PerfUtils
+
+#endif  // PERFUTILS_WINDOWEDHISTOGRAM_H
@@ -0,0 +1,90 @@
+/* Copyright (c) 2018 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "WindowedHistogram.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using PerfUtils::Cycles;
+using PerfUtils::Histogram;
+using PerfUtils::WindowedHistogram;
+
+// Return the cycle counter value for a time in seconds, offset so that it
+// is never zero.
+static uint64_t
+at(double seconds) {
+    return Cycles::fromSeconds(1000) + Cycles::fromSeconds(seconds);
+}
+
+TEST(WindowedHistogramTest, windows) {
+    WindowedHistogram windowed(1.0, 10);
+    EXPECT_EQ(10U, windowed.getNumIntervals());
+    EXPECT_EQ(0U, windowed.snapshot(10, at(0)).getCount());
+
+    windowed.record(100, at(0));
+    for (int i = 0; i < 999; i++)
+        windowed.record(100, at(0.5));
+    for (int i = 0; i < 1000; i++)
+        windowed.record(200, at(1.5));
+    windowed.record(300, at(5.5));
+
+    Histogram last = windowed.snapshot(1, at(5.9));
+    EXPECT_EQ(1U, last.getCount());
+    EXPECT_EQ(300U, last.getMin());
+
+    Histogram five = windowed.snapshot(5, at(5.9));
+    EXPECT_EQ(1001U, five.getCount());
+    EXPECT_EQ(200U, five.getMin());
+
+    // Windows are rounded up to whole intervals and limited to the ring.
+    EXPECT_EQ(1001U, windowed.snapshot(4.2, at(5.9)).getCount());
+    EXPECT_EQ(2001U, windowed.snapshot(60, at(5.9)).getCount());
+}
+
+TEST(WindowedHistogramTest, expiresOldIntervals) {
+    WindowedHistogram windowed(1.0, 10);
+    windowed.record(100, at(0));
+    windowed.record(200, at(1.5));
+    windowed.record(300, at(5.5));
+
+    // The ring now covers [2, 12), so the first two values are gone.
+    Histogram all = windowed.snapshot(10, at(11.5));
+    EXPECT_EQ(1U, all.getCount());
+    EXPECT_EQ(300U, all.getMax());
+
+    // Recording far in the future clears the whole ring.
+    windowed.record(400, at(100.2));
+    all = windowed.snapshot(10, at(100.3));
+    EXPECT_EQ(1U, all.getCount());
+    EXPECT_EQ(400U, all.getMin());
+    EXPECT_EQ(0U, windowed.snapshot(10, at(200)).getCount());
+}
+
+TEST(WindowedHistogramTest, computeStatistics) {
+    WindowedHistogram windowed(1.0, 60, 3, 1000000);
+    Histogram expected(3, 1000000);
+    EXPECT_EQ(60 * expected.getMemorySize(), windowed.getMemorySize());
+    for (uint64_t i = 1; i <= 1000; i++) {
+        windowed.record(i);
+        expected.record(i);
+    }
+    Statistics stats = windowed.computeStatistics(60);
+    EXPECT_EQ(1000U, stats.count);
+    EXPECT_EQ(1U, stats.min);
+    EXPECT_EQ(1000U, stats.max);
+    EXPECT_EQ(expected.computeStatistics().median, stats.median);
+    EXPECT_EQ(expected.computeStatistics().P99, stats.P99);
+}